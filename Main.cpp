@@ -2,8 +2,12 @@
 #include <GL/freeglut.h>
 #include "GLImage.h"
 #include "GLRenderer.h"
+#include "ImageWriter.h"
+#include "MeshFile.h"
 #include "MeshReader.h"
 #include "MeshSweeper.h"
+#include "PagedMesh.h"
+#include "TiledImage.h"
 #include "RayTracer.h"
 #include "pugixml.hpp"
 #include "Parser.h"
@@ -11,6 +15,8 @@
 
 #define WIN_W 1024
 #define WIN_H 768
+// Maximum number of sample passes of a progressive ray traced frame
+#define MAX_PASSES 64
 
 using namespace Graphics;
 
@@ -191,7 +197,17 @@ displayCallback()
       frame->unlock();
       timestamp = ct;
     }
+    else if (rayTracer->getNumberOfPasses() < MAX_PASSES)
+    {
+      // while the camera stands still, refine the frame one pass at
+      // a time, so that the window keeps responding
+      frame->lock(ImageBuffer::Write);
+      rayTracer->refineImage(*frame);
+      frame->unlock();
+    }
     frame->draw();
+    if (rayTracer->getNumberOfPasses() < MAX_PASSES)
+      glutPostRedisplay();
   }
   else if (trace_adaptativeFlag)
   {
@@ -359,12 +375,93 @@ createTestScene()
 	return scene;
 }
 
+int
+convertMesh(const char* objFileName, const char* meshFileName)
+{
+  ObjectPtr<TriangleMesh> mesh = MeshReader().execute(objFileName);
+
+  if (mesh == 0)
+  {
+    printf("Cannot read %s\n", objFileName);
+    return EXIT_FAILURE;
+  }
+  // A .pmesh is written in chunks for out-of-core rendering
+  bool ok = PagedMesh::isPagedMeshFile(meshFileName) ?
+    PagedMesh::write(meshFileName, mesh->getData()) :
+    MeshFile::write(meshFileName, mesh->getData());
+
+  if (!ok)
+  {
+    printf("Cannot write %s\n", meshFileName);
+    return EXIT_FAILURE;
+  }
+  printf("%s: %d vertices, %d triangles\n",
+    meshFileName,
+    mesh->getData().numberOfVertices,
+    mesh->getData().numberOfTriangles);
+  return EXIT_SUCCESS;
+}
+
+int
+renderTiles(const char* fileName,
+  int passes,
+  const RayTracer::Options& options)
+{
+  // The image goes straight into a mapped PPM file, tile by tile
+  TiledImage* image = TiledImage::create(fileName, W, H);
+
+  if (image == 0)
+  {
+    printf("Cannot create %s\n", fileName);
+    return EXIT_FAILURE;
+  }
+  camera->setAspectRatio(REAL(W) / REAL(H));
+  rayTracer = new RayTracer(*scene, camera, options);
+  rayTracer->renderTiles(*image, passes);
+  delete image;
+  return EXIT_SUCCESS;
+}
+
+int
+renderToFile(const char* fileName,
+  int passes,
+  const RayTracer::Options& options)
+{
+  // Rows are encoded and written by the writer thread while the next
+  // ones are traced
+  ImageWriter* image = ImageWriter::open(fileName, W, H);
+
+  if (image == 0)
+  {
+    printf("Cannot create %s\n", fileName);
+    return EXIT_FAILURE;
+  }
+  camera->setAspectRatio(REAL(W) / REAL(H));
+  rayTracer = new RayTracer(*scene, camera, options);
+  rayTracer->refineImage(*image, passes);
+
+  bool ok = image->close();
+
+  delete image;
+  if (!ok)
+  {
+    printf("Cannot write %s\n", fileName);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
 int
 main(int argc, char **argv)
 {
-  if (argc != 2)
+  // -convert file.obj file.bmesh: write a binary mesh file and exit
+  // (or a paged mesh file, if the extension is .pmesh)
+  if (argc == 4 && strcmp(argv[1], "-convert") == 0)
+    return convertMesh(argv[2], argv[3]);
+  if (argc < 2)
   {
-    printf("Informe o arquivo XML com a cena.");
+    printf("Informe o arquivo XML com a cena [-sbvh] [-lazy] [-compact] "
+      "[-o imagem.ppm|.pfm|.png [-passes n] [-tiled]].");
     return 0;
   }
 
@@ -374,6 +471,36 @@ main(int argc, char **argv)
   camera = sceneParser->parseCamera();
   scene = sceneParser->parseScene();
 
+  // -sbvh: build the mesh BVHs with spatial splits
+  // -lazy: build the mesh BVHs only when first hit by a ray
+  // -compact: trace quantized copies of the meshes
+  // -o file [-passes n]: ray trace n passes (default 1) into an image
+  // file and exit, without a window
+  // -tiled: with -o, render tile by tile into a mapped PPM file, for
+  // images larger than memory
+  RayTracer::Options options;
+  const char* imageFileName = 0;
+  int passes = 1;
+  bool tiled = false;
+
+  for (int i = 2; i < argc; i++)
+    if (strcmp(argv[i], "-sbvh") == 0)
+      options.bvh.spatialSplits = true;
+    else if (strcmp(argv[i], "-lazy") == 0)
+      options.lazyBuild = true;
+    else if (strcmp(argv[i], "-compact") == 0)
+      options.compactMeshes = true;
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      imageFileName = argv[++i];
+    else if (strcmp(argv[i], "-passes") == 0 && i + 1 < argc)
+      passes = dMax(atoi(argv[++i]), 1);
+    else if (strcmp(argv[i], "-tiled") == 0)
+      tiled = true;
+  if (imageFileName != 0)
+    return tiled ?
+      renderTiles(imageFileName, passes, options) :
+      renderToFile(imageFileName, passes, options);
+
   // init OpenGL
   initGL(&argc, argv);
   glutDisplayFunc(displayCallback);
@@ -389,7 +516,7 @@ main(int argc, char **argv)
   render = new GLRenderer(*scene, camera);
   render->renderMode = GLRenderer::Smooth;
 
-  rayTracer = new RayTracer(*scene, camera);
+  rayTracer = new RayTracer(*scene, camera, options);
 
   // print usage
   printControls();
@@ -0,0 +1,132 @@
+#ifndef __AccumulationBuffer_h
+#define __AccumulationBuffer_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: AccumulationBuffer.h
+//  ========
+//  Class definition for HDR accumulation buffer.
+
+#include <vector>
+#include "Image.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// AccumulationBuffer: HDR accumulation buffer class
+// ==================
+//
+// Floating point sums of the samples taken in each pixel of an image,
+// and their number. Samples are added unclamped; the average of each
+// pixel is tone mapped and quantized only when the buffer is written
+// to an image, so further samples refine it instead of starting over.
+// With clamping and exposure 1, a buffer with one sample per pixel
+// writes exactly the pixels of those samples clamped to [0,1]. HDR
+// images get the averages scaled by the exposure, not tone mapped.
+// Writing to an image of another size writes only the pixels both
+// have; the other pixels of the image are black.
+//
+class AccumulationBuffer
+{
+public:
+  enum ToneMapping
+  {
+    Clamp,
+    Reinhard
+  };
+
+  // Constructor
+  AccumulationBuffer():
+    W(0),
+    H(0),
+    toneMapping(Clamp),
+    exposure(1)
+  {
+    // do nothing
+  }
+
+  int getWidth() const
+  {
+    return W;
+  }
+
+  int getHeight() const
+  {
+    return H;
+  }
+
+  ToneMapping getToneMapping() const
+  {
+    return toneMapping;
+  }
+
+  float getExposure() const
+  {
+    return exposure;
+  }
+
+  void setToneMapping(ToneMapping tm)
+  {
+    toneMapping = tm;
+  }
+
+  void setExposure(float e)
+  {
+    exposure = e;
+  }
+
+  // Resize the buffer, discarding its samples if the size changed
+  void resize(int, int);
+  // Discard all samples
+  void clear();
+
+  void add(int i, int j, const Color& c)
+  {
+    int k = j * W + i;
+
+    sums[k] += c;
+    counts[k]++;
+  }
+
+  int getNumberOfSamples(int i, int j) const
+  {
+    return counts[j * W + i];
+  }
+
+  // Average of the samples of a pixel
+  Color getColor(int, int) const;
+  // Tone mapped average of the samples of a pixel
+  Color getToneMappedColor(int, int) const;
+
+  // Write the tone mapped buffer to an image
+  void write(Image&) const;
+  // Write a row of the tone mapped buffer to an image
+  void write(Image&, int) const;
+
+private:
+  int W;
+  int H;
+  ToneMapping toneMapping;
+  float exposure;
+  std::vector<Color> sums;
+  std::vector<int> counts;
+  // Row being written to an image, reused by every row
+  mutable std::vector<Color> colorRow;
+  mutable std::vector<Pixel> pixelRow;
+
+}; // AccumulationBuffer
+
+} // end namespace Graphics
+
+#endif // __AccumulationBuffer_h
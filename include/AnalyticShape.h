@@ -0,0 +1,70 @@
+#ifndef __AnalyticShape_h
+#define __AnalyticShape_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: AnalyticShape.h
+//  ========
+//  Class definition for analytic shape.
+
+#include "TriangleMeshShape.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// AnalyticShape: analytic shape class
+// =============
+//
+// Basic shape with both a tessellation, drawn by the GL renderer, and
+// an exact surface, intersected by the ray tracer. The mesh must be
+// the canonical one of the shape (see MeshCache), since both are
+// placed by the transform of the primitive.
+//
+class AnalyticShape: public TriangleMeshShape
+{
+public:
+  enum Type
+  {
+    Sphere,
+    Box,
+    Cylinder,
+    Cone
+  };
+
+  // Constructor
+  AnalyticShape(Type t, TriangleMesh* m):
+    TriangleMeshShape(m),
+    type(t)
+  {
+    // do nothing
+  }
+
+  Type getType() const
+  {
+    return type;
+  }
+
+  Object* clone() const;
+
+  // Get the exact shape in local space, shared by all shapes of a type
+  Model* getShape() const;
+
+private:
+  Type type;
+
+}; // AnalyticShape
+
+} // end namespace Graphics
+
+#endif // __AnalyticShape_h
@@ -0,0 +1,138 @@
+#ifndef __Arena_h
+#define __Arena_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: Arena.h
+//  ========
+//  Class definition for memory arena.
+
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+
+namespace System
+{ // begin namespace System
+
+#define ARENA_BLOCK_SIZE (2 << 20) // a large page on most systems
+
+
+//////////////////////////////////////////////////////////
+//
+// Arena: memory arena class
+// =====
+//
+// Bump allocator for objects that share one lifetime. Memory is
+// taken from the system in large blocks (backed by large pages when
+// available) and is only given back, all at once, by clear() or by
+// the destructor, which also destroy the objects registered with
+// own(). Objects allocated from an arena must not be deleted.
+// Allocations can be made by concurrent threads; clearing cannot.
+//
+class Arena
+{
+public:
+  // Constructor
+  Arena(size_t = ARENA_BLOCK_SIZE);
+
+  // Destructor
+  ~Arena()
+  {
+    clear();
+  }
+
+  void* allocate(size_t, size_t = 16);
+  void clear();
+
+  // Allocate uninitialized memory for n objects
+  template <typename T>
+  T* allocate(int n)
+  {
+    return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+  }
+
+  // Allocate and default construct n objects
+  template <typename T>
+  T* newArray(int n)
+  {
+    T* p = allocate<T>(n);
+
+    for (int i = 0; i < n; i++)
+      new(p + i) T();
+    own(p, n);
+    return p;
+  }
+
+  // Destroy the n objects at p when the arena is cleared
+  template <typename T>
+  void own(T* p, int n)
+  {
+    if (!std::is_trivially_destructible<T>::value)
+      addFinalizer(p, n, &destroy<T>);
+  }
+
+  // Get number of bytes handed out
+  size_t size() const
+  {
+    return allocated;
+  }
+
+  // Get number of bytes taken from the system
+  size_t capacity() const
+  {
+    return reserved;
+  }
+
+private:
+  struct Block
+  {
+    Block* next;
+    size_t size;
+
+  }; // Block
+
+  struct Finalizer
+  {
+    Finalizer* next;
+    void (*destroy)(void*, int);
+    void* data;
+    int count;
+
+  }; // Finalizer
+
+  size_t blockSize;
+  Block* blocks;
+  char* top;
+  char* end;
+  Finalizer* finalizers;
+  size_t allocated;
+  size_t reserved;
+  std::mutex lock;
+
+  Arena(const Arena&) = delete;
+  Arena& operator =(const Arena&) = delete;
+
+  void addBlock(size_t);
+  void addFinalizer(void*, int, void (*)(void*, int));
+
+  template <typename T>
+  static void destroy(void* p, int n)
+  {
+    for (T* t = static_cast<T*>(p); n > 0; n--, t++)
+      t->~T();
+  }
+
+}; // Arena
+
+} // end namespace System
+
+#endif // __Arena_h
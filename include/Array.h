@@ -97,6 +97,7 @@ public:
   }
 
   void add(const T&);
+  void add(T&&);
   void addAt(const T&, int);
   bool removeAt(int);
   void clear();
@@ -227,6 +228,15 @@ Array<T>::add(const T& t)
   constructArray<T>(data + count++, &t, 1);
 }
 
+template <typename T>
+void
+Array<T>::add(T&& t)
+{
+  if (count >= capacity)
+    resize();
+  new(data + count++) T(std::move(t)); // placement move constructor
+}
+
 template <typename T>
 void
 Array<T>::addAt(const T& t, int i)
@@ -16,6 +16,7 @@
 //  Class definition for BVH.
 
 #include "BVHNode.h"
+#include "BVHStatistics.h"
 #include "TriangleMeshShape.h"
 
 
@@ -26,8 +27,40 @@
 class BVH: public Aggregate
 {
 public:
-  /// Constructs a BVH object from model array.
-  BVH(Array<ModelPtr>&&);
+  /// BVH builder options.
+  struct Options
+  {
+    // Maximum number of models in a leaf
+    int32 maxLeafSize;
+    // Maximum depth of the tree, at most BVH_MAX_LEVEL; nodes at this
+    // level become leaves regardless of their size
+    int32 maxLevel;
+    // Also consider spatial splits (SBVH): models straddling a
+    // split plane are clipped and referenced by both children
+    bool spatialSplits;
+    // Spatial splits are tried only if the overlap of the children
+    // of the best object split, relative to the root area, exceeds
+    // this value
+    REAL splitAlpha;
+    // Maximum number of extra references, relative to the number
+    // of models
+    REAL duplicationBudget;
+
+    Options():
+      maxLeafSize(8),
+      maxLevel(BVH_MAX_LEVEL),
+      spatialSplits(false),
+      splitAlpha(REAL(1e-5)),
+      duplicationBudget(REAL(0.5))
+    {
+      // do nothing
+    }
+
+  }; // Options
+
+  /// Constructs a BVH object from model array. The nodes are
+  /// allocated from the arena, if any, which must outlive the BVH.
+  BVH(Array<ModelPtr>&&, const Options& = Options(), Arena* = 0);
 
   /// Destructor.
   ~BVH();
@@ -47,6 +80,13 @@ public:
     return maxLevel;
   }
 
+  const Options& getOptions() const
+  {
+    return options;
+  }
+
+  BVHStatistics getStatistics() const;
+
   void dump(const char* fileName) const
   {
     FILE* file = fopen(fileName, "w");
@@ -56,21 +96,28 @@ public:
   }
 
   bool intersect(const Ray&, Intersection&) const;
+  vec3 normal(const Intersection&) const;
   Bounds3 boundingBox() const;
 
 protected:
   Array<ModelPtr> models;
 
 private:
+  Options options;
+  Arena* arena;
   BVHNode* nodes;
   int32 numberOfNodes;
   int32 maxLevel;
 
+  void allocateNodes(int32);
   void build(BVHNode&, int32, int32);
   void split(BVHNode&, int32);
+  void collect(BVHStatistics&, int32, int32) const;
 
   static void dump(const BVHNode*, int32, FILE* = stdout);
 
+  friend class SBVHBuilder;
+
 }; // BVH
 
 #endif // __BVH_h
@@ -100,12 +100,18 @@ intersectLeaf(
     Intersection h;
 
     if (models[i]->intersect(ray, h) && h.distance < hit.distance)
+    {
       hit = h;
+      hit.primitive = i;
+    }
   }
   return hit.distance;
 }
 
-#define BVH_STACK_SIZE 30
+// The traversal stack holds at most one entry per level plus the
+// sentinel, so builders must not go deeper than BVH_MAX_LEVEL
+#define BVH_STACK_SIZE 64
+#define BVH_MAX_LEVEL (BVH_STACK_SIZE - 2)
 
 inline __host__ __device__ bool
 intersectBVH(
@@ -117,7 +123,7 @@ intersectBVH(
   Bounds3::PreparedRay r(ray);
 
   hit.distance = r.maxD;
-  hit.object = 0;
+  hit.primitive = -1;
   {
     REAL d;
 
@@ -134,11 +140,7 @@ intersectBVH(
   {
     if (node->lChild() < 0)
     {
-      Intersection h;
-
-      h.distance = hit.distance;
-      if (intersectLeaf(node, models, ray, h) < hit.distance)
-        hit = h;
+      intersectLeaf(node, models, ray, hit);
       node = bvh + stack[--top];
       continue;
     }
@@ -168,7 +170,7 @@ intersectBVH(
         node = bvh + stack[--top];
     } while (top != 0 && node->lChild() >= 0);
   }
-  return hit.object != 0;
+  return hit.primitive >= 0;
 }
 
 #endif // __BVHNode_h
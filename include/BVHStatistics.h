@@ -0,0 +1,78 @@
+#ifndef __BVHStatistics_h
+#define __BVHStatistics_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: BVHStatistics.h
+//  ========
+//  Class definition for BVH statistics.
+
+#include <stdio.h>
+#include <vector>
+#include "Geometry/Bounds3.h"
+
+using namespace Ds;
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// BVHStatistics: BVH statistics class
+// =============
+//
+// Quality and memory report of a BVH. Trees fill it by calling
+// addNode() for every interior node and addLeaf() for every leaf,
+// then finish(). Area-weighted quantities are relative to the area
+// of the root, i.e., they are expected values for a random ray that
+// hits the root.
+//
+class BVHStatistics
+{
+public:
+  // Cost of traversing a node and of intersecting a model
+  static const int traversalCost = 1;
+  static const int intersectionCost = 1;
+
+  int numberOfNodes;
+  int numberOfLeaves;
+  int numberOfReferences; // models referenced by leaves
+  int maxDepth;
+  REAL sahCost; // expected cost of a ray query
+  REAL overlap; // expected number of sibling overlaps hit by a ray
+  size_t bytes; // memory used by the tree
+  std::vector<int> leafSizes; // histogram of models per leaf
+  std::vector<int> depths; // histogram of leaf depths
+
+  // Constructor
+  BVHStatistics()
+  {
+    reset();
+  }
+
+  void reset();
+  void addNode(const Bounds3&, const Bounds3&, const Bounds3&, int);
+  void addLeaf(const Bounds3&, int, int);
+  void finish(const Bounds3&);
+  void print(const char* = 0, FILE* = stdout) const;
+
+  static REAL overlapArea(const Bounds3&, const Bounds3&);
+
+private:
+  REAL sahArea;
+  REAL overlapAreaSum;
+
+}; // BVHStatistics
+
+} // end namespace Graphics
+
+#endif // __BVHStatistics_h
@@ -0,0 +1,164 @@
+#ifndef __CompactMesh_h
+#define __CompactMesh_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: CompactMesh.h
+//  ========
+//  Class definition for compact triangle mesh.
+
+#include <stdint.h>
+#include <vector>
+#include "TriangleMeshShape.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// CompactMesh: compact triangle mesh class
+// ===========
+//
+// Read-only copy of a triangle mesh for ray tracing, in about a third
+// of the memory. Positions are quantized to 16 bits per coordinate
+// against the mesh bounds, normals are octahedral-encoded in two 16 bit
+// values, and triangles take 16 bit indices if the mesh has at most
+// 65536 vertices. Everything is decoded on the fly. Shared vertices
+// are quantized alike, so the mesh stays watertight; a vertex moves at
+// most 1/131070 of the mesh extent. Vertex colors are not kept.
+//
+class CompactMesh: public Object
+{
+public:
+  // Constructor
+  CompactMesh(const TriangleMesh::Arrays&);
+
+  int getNumberOfVertices() const
+  {
+    return (int)(positions.size() / 3);
+  }
+
+  int getNumberOfTriangles() const
+  {
+    return numberOfTriangles;
+  }
+
+  bool hasNormals() const
+  {
+    return !normals.empty();
+  }
+
+  Bounds3 boundingBox() const
+  {
+    return bounds;
+  }
+
+  vec3 vertex(int i) const
+  {
+    const uint16_t* q = &positions[3 * i];
+
+    return origin + vec3(q[0] * scale.x, q[1] * scale.y, q[2] * scale.z);
+  }
+
+  vec3 normal(int) const;
+
+  void triangle(int t, int v[3]) const
+  {
+    if (!shortIndices.empty())
+      for (int k = 0; k < 3; k++)
+        v[k] = shortIndices[3 * t + k];
+    else
+      for (int k = 0; k < 3; k++)
+        v[k] = indices[3 * t + k];
+  }
+
+  // Bytes taken by the arrays
+  size_t size() const;
+
+private:
+  Bounds3 bounds;
+  vec3 origin;
+  vec3 scale;
+  int numberOfTriangles;
+  std::vector<uint16_t> positions;
+  std::vector<int16_t> normals;
+  std::vector<uint16_t> shortIndices;
+  std::vector<int32_t> indices;
+
+}; // CompactMesh
+
+
+//////////////////////////////////////////////////////////
+//
+// CompactMeshShape: compact triangle mesh shape class
+// ================
+class CompactMeshShape: public Primitive
+{
+public:
+  // Constructor
+  CompactMeshShape(CompactMesh* m):
+    mesh(m)
+  {
+    // do nothing
+  }
+
+  const CompactMesh* getMesh() const
+  {
+    return mesh;
+  }
+
+  bool canIntersect() const;
+  Array<ModelPtr> refine(Arena* = 0) const;
+  bool intersect(const Ray&, Intersection&) const;
+  vec3 normal(const Intersection&) const;
+  Bounds3 boundingBox() const;
+
+private:
+  ObjectPtr<CompactMesh> mesh;
+
+}; // CompactMeshShape
+
+
+//////////////////////////////////////////////////////////
+//
+// CompactTriangleShape: compact triangle shape class
+// ====================
+//
+// Triangle of a compact mesh. The mesh is borrowed: the shape that
+// refined it must outlive the triangle.
+//
+class CompactTriangleShape: public Model
+{
+public:
+  // Constructor
+  CompactTriangleShape(const CompactMesh* m, int t):
+    mesh(m),
+    index(t)
+  {
+    // do nothing
+  }
+
+  bool intersect(const Ray&, Intersection&) const;
+  vec3 normal(const Intersection&) const;
+  const Material* getMaterial() const;
+  Bounds3 boundingBox() const;
+  Bounds3 clippedBoundingBox(const Bounds3&) const;
+
+private:
+  const CompactMesh* mesh;
+  int index;
+
+}; // CompactTriangleShape
+
+} // end namespace Graphics
+
+#endif // __CompactMesh_h
@@ -0,0 +1,115 @@
+#ifndef __DynamicBVH_h
+#define __DynamicBVH_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: DynamicBVH.h
+//  ========
+//  Class definition for dynamic BVH.
+
+#include "BVHStatistics.h"
+#include "Model.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// DynamicBVH: dynamic BVH class
+// ==========
+//
+// Top-level BVH whose leaves can be inserted, removed and updated
+// one at a time in O(log n). Sibling selection follows the SAH and
+// the tree is kept balanced by AVL-like rotations. The id returned
+// by insert() (a proxy) is stable until the leaf is removed.
+//
+class DynamicBVH: public Aggregate
+{
+public:
+  // Constructor
+  DynamicBVH(int32 = 16);
+
+  // Destructor
+  ~DynamicBVH();
+
+  int32 insert(Model*);
+  void remove(int32);
+  void update(int32);
+  void update(int32, Model*);
+
+  Model* getModel(int32 proxy) const
+  {
+    return nodes[proxy].model;
+  }
+
+  int32 size() const
+  {
+    return numberOfNodes;
+  }
+
+  int32 getNumberOfLeaves() const
+  {
+    return numberOfLeaves;
+  }
+
+  int32 getHeight() const
+  {
+    return root == -1 ? 0 : nodes[root].height;
+  }
+
+  BVHStatistics getStatistics() const;
+
+  bool intersect(const Ray&, Intersection&) const;
+  vec3 normal(const Intersection&) const;
+  Bounds3 boundingBox() const;
+
+private:
+  struct Node: public Bounds3
+  {
+    int32 parent; // or next free node
+    int32 c1;
+    int32 c2;
+    int32 height; // 0 for leaves, -1 for free nodes
+    Model* model;
+
+    bool isLeaf() const
+    {
+      return c1 == -1;
+    }
+
+    bool intersect(const PreparedRay& r, REAL& d) const
+    {
+      return Bounds3::intersect(*this, r, d);
+    }
+
+  }; // Node
+
+  Node* nodes;
+  int32 capacity;
+  int32 numberOfNodes;
+  int32 numberOfLeaves;
+  int32 freeList;
+  int32 root;
+
+  int32 allocateNode();
+  void freeNode(int32);
+  void insertLeaf(int32);
+  void removeLeaf(int32);
+  void refit(int32);
+  int32 balance(int32);
+  void collect(BVHStatistics&, int32, int32) const;
+
+}; // DynamicBVH
+
+} // end namespace Graphics
+
+#endif // __DynamicBVH_h
@@ -23,6 +23,23 @@ namespace Graphics
 { // begin namespace Graphics
 
 
+//////////////////////////////////////////////////////////
+//
+// GLInstance: GL mesh instance struct
+// ==========
+//
+// Per-instance data of an instanced draw, read by the vertex shader
+// as attributes: model-view matrix at locations 3 to 6 and normal
+// matrix at locations 7 to 9.
+//
+struct GLInstance
+{
+  mat4f mvMatrix;
+  mat3f normalMatrix;
+
+}; // GLInstance
+
+
 //////////////////////////////////////////////////////////
 //
 // GLVertexArray: GL vertex array class
@@ -43,6 +60,10 @@ public:
     glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0);
   }
 
+  // Render instances of the triangles, reading a number of GLInstance
+  // from a buffer, starting at a given one
+  void render(GLuint, int, int);
+
 private:
   GLuint vao;
   GLuint buffers[4];
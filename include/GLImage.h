@@ -26,6 +26,19 @@ namespace Graphics
 //
 // GLImage: GL image class
 // =======
+//
+// Image shown as a texture. The whole frame is kept in memory, and
+// only the rows changed since the last draw are uploaded to the
+// texture by draw(). Dirty rows are copied to one of two pixel buffer
+// objects, mapped once for good, and uploaded asynchronously from it
+// while the next upload goes through the other one; a fence guards
+// each buffer until the upload from it is done. Without persistent
+// mapping (GL 4.4 or ARB_buffer_storage), dirty rows are uploaded
+// straight from memory.
+//
+// The buffer returned by lock() is the whole frame. Unlocking an image
+// locked to write makes all of its rows dirty.
+//
 class GLImage: public ImageBuffer
 {
 public:
@@ -59,8 +72,18 @@ protected:
   void unmap();
 
 private:
-  GLuint handle;
-  Pixel* buffer;
+  GLuint texture;
+  Pixel* frame;
+  GLuint pbo[2];
+  mutable GLsync fences[2];
+  Pixel* staging[2];
+  mutable int current; // staging buffer of the next upload
+  // Rows of the frame written since the last upload
+  mutable int dirtyBegin;
+  mutable int dirtyEnd;
+  LockMode lockMode;
+
+  void upload() const;
 
 }; // GLImage
 
@@ -15,6 +15,7 @@
 //  ========
 //  Class definition for GL renderer.
 
+#include <vector>
 #include "GLGismoDrawer.h"
 #include "Renderer.h"
 #include "TriangleMesh.h"
@@ -29,6 +30,12 @@ namespace Graphics
 //
 // GLRenderer: GL renderer class
 // ==========
+//
+// Actors whose bounds are out of the view frustum are not drawn. The
+// others are sorted by mesh and material, and each run of actors that
+// share both is drawn by a single instanced draw, with the matrices of
+// the actors in a buffer of instances filled once per frame.
+//
 class GLRenderer: public Renderer, public GLGismoDrawer
 {
 public:
@@ -91,9 +98,7 @@ private:
 
   GLSL::Program program;
   mat4f viewportMatrix;
-  GLint mvMatrixLoc;
-  GLint normalMatrixLoc;
-  GLint mvpMatrixLoc;
+  GLint projectionMatrixLoc;
   GLint viewportMatrixLoc;
   GLint nbLightsLoc;
   LightLoc lightLocs[MAX_LIGHTS];
@@ -107,10 +112,18 @@ private:
   GLuint lineColorMixIdx;
   GLuint modelMaterialIdx;
   GLuint colorMapMaterialIdx;
+  GLuint instanceBuffer;
+  // Visible models and their instances, reused from frame to frame
+  std::vector<const Model*> visibleModels;
+  std::vector<GLInstance> instances;
 
   void getUniformLocations();
   void getSubroutineIndices();
   void renderDefaultLights();
+  GLInstance makeInstance(const Model*, const mat4&) const;
+  void uploadInstances();
+  void drawInstances(const Model*, int, int);
+  void drawModelGismos(const Model*);
 
 }; // GLRenderer
 
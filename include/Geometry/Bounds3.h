@@ -278,8 +278,12 @@ protected:
       return (d = tmin) < r.maxD;
     if (amax < tmax)
       tmax = amax;
+    // The ray starts inside the box: it hits whatever the exit distance
     if (tmax > r.minD)
-      return (d = tmax) < r.maxD;
+    {
+      d = tmax;
+      return r.minD < r.maxD;
+    }
     return false;
   }
 
@@ -33,7 +33,7 @@
 #ifndef __Ray_h
 #define __Ray_h
 
-#include "Math/Matrix4x4.h"
+#include "Math/Matrix3x4.h"
 
 DS_BEGIN_NAMESPACE
 
@@ -76,6 +76,17 @@ struct Ray
     set(m.transform(ray.origin), m.transformVector(ray.direction));
   }
 
+  /// Constructs a Ray object from ray transformed by the affine
+  /// matrix m. The direction is not normalized, so the distances
+  /// along the ray are the same in both spaces.
+  __host__ __device__
+  Ray(const Ray& ray, const mat3x4& m):
+    maxD(ray.maxD),
+    minD(ray.minD)
+  {
+    set(m.transform(ray.origin), m.transformVector(ray.direction));
+  }
+
   __host__ __device__
   void set(const vec3& o, const vec3& d)
   {
@@ -112,6 +112,40 @@ public:
   virtual void getSize(int&, int&) const = 0;
   virtual void write(int, Pixel[]) = 0;
 
+  // True if the image keeps unclamped colors (see writeHDR())
+  virtual bool isHDR() const
+  {
+    return false;
+  }
+
+  // True if rows are best written from the top (row H - 1) down
+  virtual bool isTopDown() const
+  {
+    return false;
+  }
+
+  // Write a row of unclamped colors; by default they are clamped to
+  // [0,1] and written as pixels
+  virtual void writeHDR(int j, const Color c[])
+  {
+    int w, h;
+
+    getSize(w, h);
+
+    Pixel* pixels = new Pixel[w];
+
+    for (int i = 0; i < w; i++)
+    {
+      Color t = c[i];
+
+      for (int k = 0; k < 3; k++)
+        t[k] = t[k] < 0 ? 0 : t[k] > 1 ? 1 : t[k];
+      pixels[i] = t;
+    }
+    write(j, pixels);
+    delete []pixels;
+  }
+
 }; // Image
 
 
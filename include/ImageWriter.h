@@ -0,0 +1,107 @@
+#ifndef __ImageWriter_h
+#define __ImageWriter_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: ImageWriter.h
+//  ========
+//  Class definition for streaming image file writer.
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "Image.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+// Maximum number of rows queued to the writer thread
+#define IMAGE_WRITER_QUEUE_SIZE 64
+
+
+//////////////////////////////////////////////////////////
+//
+// ImageWriter: streaming image file writer class
+// ===========
+//
+// Image whose rows go to a PPM, PFM or PNG file, by the extension of
+// its name, as they are written. Rows are queued to a thread of the
+// writer, which encodes and writes them while the next ones are being
+// rendered; only a few rows are held at a time, never the whole frame.
+// PPM and PFM rows have fixed places in the file and are written in any
+// order. PNG rows are compressed in file order, from the top down, so a
+// PNG writer asks for them in that order (see Image::isTopDown()); rows
+// that come early wait for their turn. A PFM writer is HDR and keeps
+// the unclamped colors.
+//
+// The file is complete only after close(), which the destructor calls.
+// Rows never written are black.
+//
+class ImageWriter: public Image
+{
+public:
+  // Create an image file, or return 0 if its format is unknown or it
+  // cannot be created
+  static ImageWriter* open(const char*, int, int);
+
+  // Destructor
+  ~ImageWriter();
+
+  void getSize(int&, int&) const;
+  void write(int, Pixel[]);
+  void writeHDR(int, const Color[]);
+  bool isHDR() const;
+  bool isTopDown() const;
+
+  // Wait for the queued rows and close the file; return false if any
+  // of them could not be written
+  bool close();
+
+  class Encoder;
+
+private:
+  struct Row
+  {
+    int j;
+    std::vector<uint8> data;
+
+  }; // Row
+
+  FILE* file;
+  Encoder* encoder;
+  int W;
+  int H;
+  int next; // number of rows written
+  std::deque<Row> queue;
+  std::map<int, std::vector<uint8>> pending;
+  std::mutex lock;
+  std::condition_variable queued;
+  std::condition_variable dequeued;
+  std::thread thread;
+  bool closing;
+  bool failed;
+
+  // Constructor
+  ImageWriter(FILE*, Encoder*, int, int);
+
+  void push(Row&);
+  void run();
+  void writeRow(int, const uint8*);
+
+}; // ImageWriter
+
+} // end namespace Graphics
+
+#endif // __ImageWriter_h
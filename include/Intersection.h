@@ -15,7 +15,6 @@
 //  ========
 //  Class definition for intersection ray/object.
 
-#include "Core/Flags.h"
 #include "Geometry/Ray.h"
 
 using namespace Ds;
@@ -23,22 +22,25 @@ using namespace Ds;
 namespace Graphics
 { // begin namespace Graphics
 
-class Model;
-class TriangleShape;
-
 
 //////////////////////////////////////////////////////////
 //
 // Intersection: intersection ray/object class
 // ============
+//
+// Plain hit record filled during traversal. Each level of the scene
+// identifies what it hit by an index: the aggregate that owns a model
+// stores the model index in primitive (a BVH) or in instance (the
+// top-level BVH). Surface attributes are evaluated from these ids
+// only once, after the closest hit is known.
+//
 struct Intersection
 {
-  const Model* object; // object intercepted by the ray
-  const TriangleShape* triangle; // triangle intercepted by the ray
   REAL distance; // distance from the ray's origin to the intersection point
-  vec3 p;  // barycentric coordinates of the intersection point
-  Flags flags; // flags
-  void* userData;   // any user data
+  REAL u; // barycentric coordinates of the intersection point
+  REAL v;
+  int32 primitive; // index of the primitive intercepted by the ray
+  int32 instance; // index of the instance intercepted by the ray
 
 }; // Intersection
 
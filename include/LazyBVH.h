@@ -0,0 +1,69 @@
+#ifndef __LazyBVH_h
+#define __LazyBVH_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: LazyBVH.h
+//  ========
+//  Class definition for lazy BVH.
+
+#include <atomic>
+#include <mutex>
+#include "BVH.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// LazyBVH: lazy BVH class
+// =======
+//
+// BVH of the refinement of a model that is not intersectable, built
+// the first time a ray enters the bounds of the model, or on demand
+// by build(). Until then, the model costs just its bounding box. The
+// build runs once even if several threads trace rays into the model
+// at the same time.
+//
+class LazyBVH: public Aggregate
+{
+public:
+  // Constructor
+  LazyBVH(Model&, const BVH::Options& = BVH::Options(), Arena* = 0);
+
+  bool intersect(const Ray&, Intersection&) const;
+  vec3 normal(const Intersection&) const;
+  Bounds3 boundingBox() const;
+
+  // Build the BVH, if not yet built
+  BVH* build() const;
+
+  // Get the BVH, or 0 if not yet built
+  BVH* getBVH() const
+  {
+    return built.load(std::memory_order_acquire) ? (BVH*)bvh : 0;
+  }
+
+private:
+  ModelPtr model;
+  BVH::Options options;
+  Arena* arena;
+  Bounds3 bounds;
+  mutable ObjectPtr<BVH> bvh;
+  mutable std::once_flag once;
+  mutable std::atomic<bool> built;
+
+}; // LazyBVH
+
+} // end namespace Graphics
+
+#endif // __LazyBVH_h
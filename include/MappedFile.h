@@ -0,0 +1,118 @@
+#ifndef __MappedFile_h
+#define __MappedFile_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: MappedFile.h
+//  ========
+//  Class definition for memory-mapped file.
+
+#include <stddef.h>
+
+namespace System
+{ // begin namespace System
+
+
+//////////////////////////////////////////////////////////
+//
+// MappedFile: memory-mapped file class
+// ==========
+//
+// View of a whole file. The pages are brought in by the system on
+// demand and are shared by all processes mapping the same file. A
+// copy-on-write view can also be written: written pages become
+// private and the file is never changed. A view of a file made by
+// create() is shared and writable: written pages go to the file.
+//
+// The pattern in which a view will be read can be given when the file
+// is opened, for the system to read ahead, or not, and to choose the
+// pages to release under memory pressure.
+//
+class MappedFile
+{
+public:
+  enum Access
+  {
+    Normal,
+    Sequential, // read once, from start to end
+    Random      // read in no particular order, e.g., by chunks
+  };
+
+  // Constructors
+  MappedFile():
+    address(0),
+    length(0)
+  {
+    // do nothing
+  }
+
+  MappedFile(const char* fileName,
+    bool copyOnWrite = false,
+    Access access = Normal):
+    address(0),
+    length(0)
+  {
+    open(fileName, copyOnWrite, access);
+  }
+
+  // Destructor
+  ~MappedFile()
+  {
+    close();
+  }
+
+  bool open(const char*, bool = false, Access = Normal);
+  // Create a file of a given size, replacing any existing one, and
+  // map it for writing
+  bool create(const char*, size_t);
+  void close();
+
+  // Release the pages of a range of the view; they are read again
+  // from the file when touched (changes to copy-on-write pages are
+  // lost; those to a created view are kept)
+  void discard(size_t, size_t);
+  // Start writing the changed pages of a range of a created view
+  // to the file
+  void flush(size_t, size_t);
+
+  bool isOpen() const
+  {
+    return address != 0;
+  }
+
+  const char* data() const
+  {
+    return address;
+  }
+
+  // Writable only if the view is copy-on-write or was created
+  char* data()
+  {
+    return address;
+  }
+
+  size_t size() const
+  {
+    return length;
+  }
+
+private:
+  char* address;
+  size_t length;
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator =(const MappedFile&) = delete;
+
+}; // MappedFile
+
+} // end namespace System
+
+#endif // __MappedFile_h
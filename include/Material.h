@@ -15,6 +15,7 @@
 // ========
 // Class definition for material.
 
+#include <mutex>
 #include "Array.h"
 #include "Graphics/Color.h"
 #include "NameableObject.h"
@@ -146,6 +147,8 @@ private:
   }; // Materials
 
   static Materials materials;
+  // Materials can be made by concurrent tasks (e.g., mesh readers)
+  static std::recursive_mutex lock;
 
   static void add(Material* material)
   {
@@ -0,0 +1,162 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2016 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: Matrix3x4.h
+// ========
+// Class definition for 3x4 affine matrix.
+//
+// Author: Orthrus Group
+// Last revision: 18/10/2026
+
+#ifndef __Matrix3x4_h
+#define __Matrix3x4_h
+
+#include "Math/Matrix4x4.h"
+
+DS_BEGIN_NAMESPACE
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Matrix3x4: 3x4 affine matrix class (row-major format)
+// =========
+//
+// The first three rows of an affine 4x4 matrix, the last one being
+// always (0, 0, 0, 1). A point is transformed with three dot products
+// and no division. Use it where a transform is applied many times,
+// e.g., to bring rays into the local space of an instance.
+//
+template <typename real>
+class alignas(4 * sizeof(real)) Matrix3x4
+{
+public:
+  typedef Vector3<real> vec3;
+  typedef Vector4<real> vec4;
+  typedef Matrix4x4<real> mat4;
+  typedef Matrix3x4<real> mat3x4;
+
+  /// Default constructor.
+  __host__ __device__
+  Matrix3x4()
+  {
+    // do nothing
+  }
+
+  /// Constructs a Matrix3x4 object from the rows [r0; r1; r2].
+  __host__ __device__
+  Matrix3x4(const vec4& r0, const vec4& r1, const vec4& r2)
+  {
+    set(r0, r1, r2);
+  }
+
+  /// Constructs a Matrix3x4 object from the first three rows of m.
+  __host__ __device__
+  explicit Matrix3x4(const mat4& m)
+  {
+    set(m);
+  }
+
+  /// Sets the rows of this object to [r0; r1; r2].
+  __host__ __device__
+  void set(const vec4& r0, const vec4& r1, const vec4& r2)
+  {
+    this->r0 = r0;
+    this->r1 = r1;
+    this->r2 = r2;
+  }
+
+  /// Sets this object to the first three rows of m.
+  __host__ __device__
+  void set(const mat4& m)
+  {
+    r0.set(m.v0.x, m.v1.x, m.v2.x, m.v3.x);
+    r1.set(m.v0.y, m.v1.y, m.v2.y, m.v3.y);
+    r2.set(m.v0.z, m.v1.z, m.v2.z, m.v3.z);
+  }
+
+  /// Returns an identity matrix.
+  __host__ __device__
+  static mat3x4 identity()
+  {
+    return mat3x4(vec4(1, 0, 0, 0), vec4(0, 1, 0, 0), vec4(0, 0, 1, 0));
+  }
+
+  /// Returns a reference to the i-th row of this object.
+  __host__ __device__
+  vec4& operator [](int i)
+  {
+    return (&r0)[i];
+  }
+
+  /// Returns the i-th row of this object.
+  __host__ __device__
+  const vec4& operator [](int i) const
+  {
+    return (&r0)[i];
+  }
+
+  /// Returns a 3D point p transformed by this object.
+  __host__ __device__
+  vec3 transform(const vec3& p) const
+  {
+    return vec3(
+      r0.x * p.x + r0.y * p.y + r0.z * p.z + r0.w,
+      r1.x * p.x + r1.y * p.y + r1.z * p.z + r1.w,
+      r2.x * p.x + r2.y * p.y + r2.z * p.z + r2.w);
+  }
+
+  /// Returns a vector v transformed by this object.
+  __host__ __device__
+  vec3 transformVector(const vec3& v) const
+  {
+    return vec3(
+      r0.x * v.x + r0.y * v.y + r0.z * v.z,
+      r1.x * v.x + r1.y * v.y + r1.z * v.z,
+      r2.x * v.x + r2.y * v.y + r2.z * v.z);
+  }
+
+  /// Returns the 4x4 matrix of this object.
+  __host__ __device__
+  mat4 toMat4() const
+  {
+    return mat4(vec4(r0.x, r1.x, r2.x, 0),
+      vec4(r0.y, r1.y, r2.y, 0),
+      vec4(r0.z, r1.z, r2.z, 0),
+      vec4(r0.w, r1.w, r2.w, 1));
+  }
+
+private:
+  vec4 r0; // row 0
+  vec4 r1; // row 1
+  vec4 r2; // row 2
+
+}; // Matrix3x4
+
+DS_END_NAMESPACE
+
+/// Default mat3x4 type.
+typedef DS_NAMESPACE::Matrix3x4<REAL> mat3x4;
+
+#endif // __Matrix3x4_h
@@ -0,0 +1,101 @@
+#ifndef __MeshCache_h
+#define __MeshCache_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: MeshCache.h
+//  ========
+//  Class definition for mesh cache.
+
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <time.h>
+#include "TriangleMesh.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// MeshCache: mesh cache class
+// =========
+//
+// Meshes read from files, keyed by path and modification time. All
+// the actors that use the same file share one mesh, which must not
+// be changed: each actor places it with the transform of its
+// primitive. A file modified since it was read is read again.
+//
+// Files are read by tasks of the default thread pool: load() starts
+// the reading and returns, and get() waits for it. Scene parsers load
+// all the files of a scene first, so that they are read concurrently.
+//
+// The cache also keeps the tessellations of the basic shapes, keyed
+// by shape and number of segments. These are canonical: sphere of
+// radius 1 centered at the origin, cube with corners (-1,-1,-1) and
+// (1,1,1), cylinder of radius 1 and height 1 centered at the origin,
+// and cone of radius 1 and height 1 with base centered at the origin,
+// the last two along the y axis. Actors place them with a transform,
+// so a scene with thousands of spheres holds a single sphere mesh.
+//
+class MeshCache
+{
+public:
+  static void load(const char* fileName)
+  {
+    find(fileName);
+  }
+
+  static TriangleMesh* get(const char*);
+
+  static TriangleMesh* getSphere(int = 16);
+  static TriangleMesh* getBox();
+  static TriangleMesh* getCylinder(int = 16);
+  static TriangleMesh* getCone(int = 16);
+
+  static void purge();
+  static void clear();
+  static int size();
+
+private:
+  typedef std::shared_future<ObjectPtr<TriangleMesh>> MeshFuture;
+
+  struct Entry
+  {
+    MeshFuture mesh;
+    time_t modified;
+
+  }; // Entry
+
+  enum Shape
+  {
+    Sphere,
+    Box,
+    Cylinder,
+    Cone
+  };
+
+  typedef std::pair<Shape, int> ShapeKey;
+
+  static std::map<std::string, Entry> meshes;
+  static std::map<ShapeKey, ObjectPtr<TriangleMesh>> shapes;
+  static std::mutex lock;
+
+  static MeshFuture find(const char*);
+  static TriangleMesh* getShape(const ShapeKey&, TriangleMesh* (*)(int));
+
+}; // MeshCache
+
+} // end namespace Graphics
+
+#endif // __MeshCache_h
@@ -0,0 +1,71 @@
+#ifndef __MeshFile_h
+#define __MeshFile_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: MeshFile.h
+//  ========
+//  Class definition for binary mesh file.
+
+#include <stdint.h>
+#include "TriangleMesh.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define MESH_FILE_MAGIC "BMSH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGNMENT 64
+
+
+//////////////////////////////////////////////////////////
+//
+// MeshFile: binary mesh file class
+// ========
+//
+// A .bmesh file is a header followed by the arrays of a triangle
+// mesh, each one starting at a multiple of MESH_FILE_ALIGNMENT, in
+// the memory layout of the build that wrote it. Reading maps the file
+// and the mesh points straight into the mapping: there is nothing to
+// parse or copy, and processes opening the same file share its pages.
+//
+class MeshFile
+{
+public:
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder; // 0x01020304 as written
+    uint32_t realSize; // sizeof(REAL)
+    int32_t numberOfVertices;
+    int32_t numberOfNormals;
+    int32_t numberOfVertexColors;
+    int32_t numberOfTriangles;
+    // Offsets of the arrays, 0 if absent
+    uint64_t vertices;
+    uint64_t normals;
+    uint64_t vertexColors;
+    uint64_t triangles;
+    uint64_t size; // file size
+
+  }; // Header
+
+  static bool write(const char*, const TriangleMesh::Arrays&);
+  static TriangleMesh* read(const char*);
+
+  static bool isMeshFile(const char*);
+
+}; // MeshFile
+
+} // end namespace Graphics
+
+#endif // __MeshFile_h
@@ -15,6 +15,7 @@
 //  ========
 //  Class definition for generic model.
 
+#include "Arena.h"
 #include "Geometry/Bounds3.h"
 #include "Intersection.h"
 #include "Material.h"
@@ -41,7 +42,7 @@ public:
   virtual ~Model();
 
   virtual bool canIntersect() const;
-  virtual Array<ModelPtr> refine() const;
+  virtual Array<ModelPtr> refine(Arena* = 0) const;
   virtual const TriangleMesh* triangleMesh() const;
   virtual bool intersect(const Ray&, Intersection&) const = 0;
   virtual vec3 normal(const Intersection&) const = 0;
@@ -49,6 +50,7 @@ public:
   virtual const mat4& getLocalToWorldMatrix() const;
   virtual const mat4& getWorldToLocalMatrix() const;
   virtual Bounds3 boundingBox() const = 0;
+  virtual Bounds3 clippedBoundingBox(const Bounds3&) const;
 
 }; // Model
 
@@ -78,7 +80,12 @@ public:
   const mat4& getWorldToLocalMatrix() const;
 
   virtual void setMaterial(Material*);
-  virtual void setTransform(const vec3&, const quat&, const vec3&);
+  virtual void setTransform(const mat4&);
+
+  void setTransform(const vec3& p, const quat& q, const vec3& s)
+  {
+    setTransform(mat4::TRS(p, q, s));
+  }
 
 protected:
   ObjectPtr<Material> material;
@@ -113,7 +120,8 @@ public:
   // Constructor
   ModelInstance(Model& m, const Primitive& p):
     Primitive(p),
-    model(&m)
+    model(&m),
+    rayTransform(p.getWorldToLocalMatrix())
   {
     // do nothing
   }
@@ -123,8 +131,13 @@ public:
   vec3 normal(const Intersection&) const;
   Bounds3 boundingBox() const;
 
+  using Primitive::setTransform;
+  void setTransform(const mat4&);
+
 private:
   ModelPtr model;
+  // World to local affine transform applied to rays
+  mat3x4 rayTransform;
 
 }; // ModelInstance
 
@@ -15,6 +15,8 @@
 //  ========
 //  Class definition for generic object.
 
+#include <atomic>
+
 namespace System
 { // begin namespace System
 
@@ -23,6 +25,13 @@ namespace System
 //
 // Object: generic object class
 // ======
+//
+// The reference counter is atomic, so objects can be shared and
+// released by several threads. Counting is still not free: ObjectPtr
+// owns objects while a scene is edited, whereas code that only reads
+// them during rendering should borrow plain pointers, whose lifetime
+// is guaranteed by the owners.
+//
 class Object
 {
 public:
@@ -41,7 +50,7 @@ public:
   // Get number of uses of this object
   int getNumberOfUses() const
   {
-    return counter;
+    return counter.load(std::memory_order_relaxed);
   }
 
   template <typename T> friend T* makeUse(T*);
@@ -49,7 +58,7 @@ public:
   // Release this object
   void release()
   {
-    if (--counter <= 0)
+    if (counter.fetch_sub(1, std::memory_order_acq_rel) <= 1)
       delete this;
   }
 
@@ -61,8 +70,20 @@ protected:
     // do nothing
   }
 
+  // Protected copy constructor: a copy has no uses
+  Object(const Object&):
+    counter(0)
+  {
+    // do nothing
+  }
+
+  Object& operator =(const Object&)
+  {
+    return *this;
+  }
+
 private:
-  int counter; // reference counter
+  std::atomic<int> counter; // reference counter
 
 }; // Object
 
@@ -77,8 +98,9 @@ template <typename T>
 inline T*
 makeUse(T* object)
 {
+  // No ordering is needed to take a new use of an object already used
   if (object != 0)
-    ++object->counter;
+    object->counter.fetch_add(1, std::memory_order_relaxed);
   return object;
 }
 
@@ -116,6 +138,13 @@ public:
     this->object = makeUse(object);
   }
 
+  // Move constructor
+  ObjectPtr(ObjectPtr<T>&& ptr):
+    object(ptr.object)
+  {
+    ptr.object = 0;
+  }
+
   // Destructor
   ~ObjectPtr()
   {
@@ -124,15 +153,30 @@ public:
 
   ObjectPtr<T>& operator =(T* object)
   {
+    makeUse(object);
     release(this->object);
-    this->object = makeUse(object);
+    this->object = object;
     return *this;
   }
 
   ObjectPtr<T>& operator =(const ObjectPtr<T>& ptr)
   {
+    // Take the new use first, in case both point to the same object
+    T* object = makeUse(ptr.object);
+
     release(this->object);
-    this->object = makeUse(ptr.object);
+    this->object = object;
+    return *this;
+  }
+
+  ObjectPtr<T>& operator =(ObjectPtr<T>&& ptr)
+  {
+    if (this != &ptr)
+    {
+      release(this->object);
+      this->object = ptr.object;
+      ptr.object = 0;
+    }
     return *this;
   }
 
@@ -166,6 +210,12 @@ public:
     return object;
   }
 
+  // Borrow the object without taking a use
+  T* get() const
+  {
+    return object;
+  }
+
 private:
   T* object; // this is the object
 
@@ -0,0 +1,203 @@
+#ifndef __PagedMesh_h
+#define __PagedMesh_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: PagedMesh.h
+//  ========
+//  Class definition for out-of-core paged mesh.
+
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+#include "BVH.h"
+#include "MappedFile.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+#define PAGED_MESH_MAGIC "PMSH"
+#define PAGED_MESH_VERSION 1
+// Default maximum number of triangles of a chunk
+#define PAGED_MESH_CHUNK_SIZE (1 << 16)
+// Default memory budget of the resident chunks of a mesh, in bytes
+#define PAGED_MESH_BUDGET (size_t(1) << 30)
+
+
+//////////////////////////////////////////////////////////
+//
+// PagedMesh: out-of-core paged mesh class
+// =========
+//
+// Triangle mesh too large to be resident, read from a .pmesh file.
+// The file holds the triangles split into spatially coherent chunks,
+// each one a small self-contained mesh, and a tree of BVH nodes whose
+// leaves are the chunks; everything is in the memory layout of the
+// build that wrote it, as in a .bmesh file (see MeshFile). The mesh
+// maps the file and pages chunks in and out: a chunk is made resident
+// (its mesh points into the mapping and its BVH is built) when a ray
+// first reaches it, and the least recently used chunks are evicted
+// whenever the resident ones exceed a memory budget.
+//
+// Rays traverse the chunk tree front to back and stop at the first
+// hit closer than the next chunk, so only the chunks rays actually
+// reach are paged in. Pages are shared by reference: a chunk evicted
+// while another thread traces it lives until that ray is done.
+//
+class PagedMesh: public Aggregate
+{
+public:
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder; // 0x01020304 as written
+    uint32_t realSize; // sizeof(REAL)
+    int32_t numberOfChunks;
+    int32_t numberOfNodes;
+    int32_t numberOfTriangles;
+    int32_t reserved;
+    // Offsets of the chunk table and of the chunk tree
+    uint64_t chunks;
+    uint64_t nodes;
+    uint64_t size; // file size
+
+  }; // Header
+
+  struct Chunk
+  {
+    vec3 p1; // bounds
+    vec3 p2;
+    int32_t firstTriangle; // in the whole mesh
+    int32_t numberOfVertices;
+    int32_t numberOfNormals;
+    int32_t numberOfVertexColors;
+    int32_t numberOfTriangles;
+    int32_t reserved;
+    // Offsets of the arrays, 0 if absent, and end of the chunk data
+    uint64_t vertices;
+    uint64_t normals;
+    uint64_t vertexColors;
+    uint64_t triangles;
+    uint64_t end;
+
+  }; // Chunk
+
+  // Write a paged mesh file
+  static bool write(const char*,
+    const TriangleMesh::Arrays&,
+    int = PAGED_MESH_CHUNK_SIZE);
+  // Open a paged mesh file, or return 0 if it cannot be mapped or was
+  // not written by a compatible build
+  static PagedMesh* open(const char*, size_t = PAGED_MESH_BUDGET);
+
+  static bool isPagedMeshFile(const char*);
+
+  bool intersect(const Ray&, Intersection&) const;
+  vec3 normal(const Intersection&) const;
+  Bounds3 boundingBox() const;
+
+  int getNumberOfChunks() const
+  {
+    return (int)pages.size();
+  }
+
+  int getNumberOfTriangles() const
+  {
+    return header->numberOfTriangles;
+  }
+
+  size_t getBudget() const
+  {
+    return budget;
+  }
+
+  void setBudget(size_t);
+
+  // Bytes taken by the resident chunks
+  size_t getResidentSize() const;
+  // Number of times a chunk was paged in
+  int getNumberOfPageIns() const;
+
+private:
+  struct Page: public Object
+  {
+    ObjectPtr<TriangleMesh> mesh;
+    ObjectPtr<BVH> bvh;
+    size_t size;
+
+  }; // Page
+
+  struct PageEntry
+  {
+    ObjectPtr<Page> page;
+    uint64_t lastUse;
+
+  }; // PageEntry
+
+  mutable MappedFile file;
+  const Header* header;
+  const Chunk* chunks;
+  const BVHNode* nodes;
+  size_t budget;
+  mutable std::vector<PageEntry> pages;
+  mutable std::mutex lock;
+  mutable size_t residentSize;
+  mutable uint64_t clock;
+  mutable int pageIns;
+
+  PagedMesh();
+
+  bool intersectChunk(int, const Ray&, Intersection&) const;
+  ObjectPtr<Page> page(int) const;
+  Page* pageIn(int) const;
+  void evict(int) const;
+
+}; // PagedMesh
+
+
+//////////////////////////////////////////////////////////
+//
+// PagedMeshShape: paged mesh shape class
+// ==============
+//
+// Primitive that places a paged mesh in a scene. It has no triangle
+// mesh, so the GL renderer does not draw it; the ray tracer traces
+// the paged mesh itself (see getPagedMesh()).
+//
+class PagedMeshShape: public Primitive
+{
+public:
+  // Constructor
+  PagedMeshShape(PagedMesh* m):
+    mesh(m)
+  {
+    // do nothing
+  }
+
+  PagedMesh* getPagedMesh() const
+  {
+    return mesh;
+  }
+
+  bool canIntersect() const;
+  bool intersect(const Ray&, Intersection&) const;
+  vec3 normal(const Intersection&) const;
+  Bounds3 boundingBox() const;
+
+private:
+  ObjectPtr<PagedMesh> mesh;
+
+}; // PagedMeshShape
+
+} // end namespace Graphics
+
+#endif // __PagedMesh_h
@@ -3,9 +3,11 @@
 #include "Camera.h"
 #include "Material.h"
 #include <string.h>
-#include "TriangleMeshShape.h"
+#include "AnalyticShape.h"
+#include "MeshCache.h"
 #include "MeshReader.h"
 #include "MeshSweeper.h"
+#include "PagedMesh.h"
 
 using namespace pugi;
 using namespace Graphics;
@@ -22,6 +24,7 @@ private:
 	Light* parseLight(xml_node_iterator);
 
 	Material* parseMaterial(xml_node);
+	mat4 parseTransform(xml_node);
 	Actor* parseSphere(xml_node_iterator);
 	Actor* parseCone(xml_node_iterator);
 	Actor* parseBox(xml_node_iterator);
@@ -15,6 +15,15 @@
 //  ========
 //  Class definition for simple ray tracer.
 
+#include <map>
+#include "AccumulationBuffer.h"
+#include "BVH.h"
+#include "CompactMesh.h"
+#include "DynamicBVH.h"
+#include "LazyBVH.h"
+#include "PagedMesh.h"
+#include "RenderScene.h"
+#include "TiledImage.h"
 #include "Image.h"
 #include "Intersection.h"
 #include "Renderer.h"
@@ -43,7 +52,7 @@ namespace Graphics
 	//
 	// RayTracer: simple ray tracer class
 	// =========
-	class RayTracer : public Renderer
+	class RayTracer : public Renderer, public SceneListener
 	{
 	public:
 		struct DebugInfo
@@ -51,11 +60,34 @@ namespace Graphics
 			Ray ray;
 			Intersection hit;
 
+		};
+
+		// Scene construction options
+		struct Options
+		{
+			// Options of the builder of the BVHs of the meshes
+			BVH::Options bvh;
+			// Build the BVHs of the meshes only when a ray first
+			// enters them (see LazyBVH)
+			bool lazyBuild;
+			// Trace compact copies of the meshes (see CompactMesh)
+			bool compactMeshes;
+
+			Options():
+				lazyBuild(false),
+				compactMeshes(false)
+			{
+				// do nothing
+			}
+
 		};
 		Coordinate**  visited;
 		Coordinate* border;
 		// Constructor
-		RayTracer(Scene&, Camera* = 0);
+		RayTracer(Scene&, Camera* = 0, const Options& = Options());
+
+		// Destructor
+		~RayTracer();
 
 		uint getMaxRecursionLevel() const
 		{
@@ -77,18 +109,57 @@ namespace Graphics
 			minWeight = dMax<REAL>(w, MIN_WEIGHT);
 		}
 
+		AccumulationBuffer& getAccumulationBuffer()
+		{
+			return accumulation;
+		}
+
+		// Number of sample passes accumulated into the last image
+		int getNumberOfPasses() const
+		{
+			return passes;
+		}
+
 		void render();
 		virtual void renderImage(Image&, bool);
+		// Add jittered sample passes to the last image rendered with
+		// renderImage(image, false) and write their average; the camera
+		// must not have changed since. If the scene has changed, or
+		// there is no such image, a new one is started
+		virtual void refineImage(Image&, int = 1);
+		// Render an image tile by tile, with a number of sample passes
+		// per tile; only the samples of one tile are held at a time
+		virtual void renderTiles(TiledImage&, int = 1);
 
 		void debug(int, int, DebugInfo&);
 
+		// Scene listener: keeps the top-level BVH in sync with the scene
+		void actorAdded(Scene&, Actor*);
+		void actorRemoved(Scene&, Actor*);
+		void actorModified(Scene&, Actor*);
+
 	protected:
-		ObjectPtr<Model> aggregate;
+		// Triangles and BVH nodes of the meshes; declared first so
+		// that it is freed after the BVHs that use it
+		Arena arena;
+		ObjectPtr<DynamicBVH> aggregate;
+		std::map<const Actor*, int32> proxies;
+		std::map<uint, ObjectPtr<LazyBVH>> aggregates;
+		Options options;
+		int totalNodes;
 		uint maxRecursionLevel;
 		REAL minWeight;
+		AccumulationBuffer accumulation;
+		int passes;
+		// Shading data of the scene, compiled at the start of a render
+		RenderScene renderScene;
 
+		void setView(Image&);
+		void compileScene();
 		virtual void scan(Image&);
+		virtual void addPass(Image* = 0);
 		virtual void setPixelRay(REAL, REAL);
+		virtual Color sample(REAL, REAL);
 		virtual Color shoot(REAL, REAL);
 		virtual void adaptativeScan(Image&);
 		virtual Color trace(const Ray&, uint, REAL);
@@ -98,6 +169,11 @@ namespace Graphics
 		virtual void clearVisitedMatrix(int, int);
 		virtual void printMatrix(int, int);
 
+		static Primitive* meshPrimitive(const Actor*);
+		LazyBVH* makeAggregate(Primitive*);
+		void buildAggregates(Scene&);
+		Model* makeInstance(const Actor*);
+
 	}; // RayTracer
 
 } // end namespace Graphics
@@ -0,0 +1,104 @@
+#ifndef __RenderScene_h
+#define __RenderScene_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: RenderScene.h
+//  ========
+//  Class definition for flat render scene.
+
+#include <map>
+#include <vector>
+#include "DynamicBVH.h"
+#include "Scene.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+
+//////////////////////////////////////////////////////////
+//
+// RenderScene: flat render scene class
+// ===========
+//
+// Snapshot of the shading data of a scene, compiled at the start of a
+// render into contiguous arrays: the lights, in the order of the scene,
+// the distinct materials of the actors, and, for each proxy of the
+// top-level BVH, the index of the material of its instance. Shading a
+// hit is then plain indexing, with no walk through the light list nor
+// virtual calls to get a material. The snapshot is not changed while
+// the render runs, so it can be read by any number of threads; changes
+// in the scene take effect in the next compile().
+//
+class RenderScene
+{
+public:
+  struct Light
+  {
+    vec3 position; // or direction, if directional
+    Color color;
+    bool directional;
+
+  }; // Light
+
+  struct Surface
+  {
+    Color ambient;
+    Color diffuse;
+    Color specular;
+
+  }; // Surface
+
+  Color backgroundColor;
+  Color ambientLight;
+
+  // Compile the snapshot of a scene whose actors are the given proxies
+  // of a top-level BVH
+  void compile(const Scene&,
+    const DynamicBVH&,
+    const std::map<const Actor*, int32>&);
+
+  int getNumberOfLights() const
+  {
+    return (int)lights.size();
+  }
+
+  const Light& getLight(int i) const
+  {
+    return lights[i];
+  }
+
+  int getNumberOfSurfaces() const
+  {
+    return (int)surfaces.size();
+  }
+
+  const Surface& getSurface(int i) const
+  {
+    return surfaces[i];
+  }
+
+  // Surface of the instance of a proxy
+  const Surface& getSurfaceOf(int32 proxy) const
+  {
+    return surfaces[materials[proxy]];
+  }
+
+private:
+  std::vector<Light> lights;
+  std::vector<Surface> surfaces;
+  std::vector<int> materials; // indexed by proxy
+
+}; // RenderScene
+
+} // end namespace Graphics
+
+#endif // __RenderScene_h
@@ -21,6 +21,28 @@
 namespace Graphics
 { // begin namespace Graphics
 
+class Scene;
+
+
+//////////////////////////////////////////////////////////
+//
+// SceneListener: scene listener class
+// =============
+class SceneListener
+{
+public:
+  // Destructor
+  virtual ~SceneListener()
+  {
+    // do nothing
+  }
+
+  virtual void actorAdded(Scene&, Actor*) = 0;
+  virtual void actorRemoved(Scene&, Actor*) = 0;
+  virtual void actorModified(Scene&, Actor*) = 0;
+
+}; // SceneListener
+
 
 //////////////////////////////////////////////////////////
 //
@@ -81,6 +103,7 @@ public:
   Light* findLight(const string&) const;
 
   void addActor(Actor*);
+  void updateActor(Actor*);
   void deleteActor(Actor*);
   void deleteActors();
   void addLight(Light*);
@@ -95,6 +118,17 @@ public:
 
   const Bounds3& boundingBox();
 
+  void addListener(SceneListener* listener)
+  {
+    if (listener != 0 && listeners.findIndex(listener) < 0)
+      listeners.add(listener);
+  }
+
+  void removeListener(SceneListener* listener)
+  {
+    listeners.remove(listener);
+  }
+
 protected:
   bool modifiedBounds;
   Bounds3 bounds;
@@ -102,6 +136,7 @@ protected:
   // Scene components
   Actors actors;
   Lights lights;
+  PointerArray<SceneListener> listeners;
 
   void updateBounds();
 
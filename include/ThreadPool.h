@@ -0,0 +1,134 @@
+#ifndef __ThreadPool_h
+#define __ThreadPool_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: ThreadPool.h
+//  ========
+//  Class definition for thread pool.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace System
+{ // begin namespace System
+
+
+//////////////////////////////////////////////////////////
+//
+// ThreadPool: thread pool class
+// ==========
+//
+// Fixed set of worker threads running tasks in the order they were
+// submitted. A thread waiting for a task with wait() or forEach() runs
+// other queued tasks meanwhile, so tasks can submit and wait for
+// other tasks (e.g., a mesh load whose reader splits the file in
+// chunks) without starving the pool. Futures of tasks must be waited
+// with wait(): a plain get() does not run queued tasks.
+//
+class ThreadPool
+{
+public:
+  // Constructor (by default, one worker less than the number of
+  // cores, but at least one)
+  ThreadPool(int = 0);
+
+  // Destructor: runs the queued tasks and joins the workers
+  ~ThreadPool();
+
+  int size() const
+  {
+    return (int)workers.size();
+  }
+
+  // Submit a task; the future gives its result
+  template <typename F>
+  auto run(F&& f) -> std::future<decltype(f())>
+  {
+    typedef decltype(f()) R;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> result = task->get_future();
+
+    submit([task]() { (*task)(); });
+    return result;
+  }
+
+  // Wait for a future of a task, running queued tasks meanwhile
+  template <typename Future>
+  void wait(const Future& f)
+  {
+    while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      if (!runPending())
+        f.wait_for(std::chrono::milliseconds(1));
+  }
+
+  // Run f(i), for i in [0, n), in the pool and in the calling thread
+  template <typename F>
+  void forEach(int n, F f)
+  {
+    std::atomic<int> next(0);
+    auto work = [&]()
+    {
+      for (int i; (i = next++) < n;)
+        f(i);
+    };
+    // No more helpers than items to share
+    int helpers = std::min(size(), n - 1);
+    std::vector<std::future<void>> tasks;
+
+    for (int i = 0; i < helpers; i++)
+      tasks.push_back(run(work));
+    work();
+    for (auto& t : tasks)
+      wait(t);
+  }
+
+  // Run f(begin, end) for the ranges of at most m items of [0, n)
+  template <typename F>
+  void forEachRange(int n, int m, F f)
+  {
+    forEach((n + m - 1) / m, [&](int i)
+    {
+      f(i * m, std::min(n, (i + 1) * m));
+    });
+  }
+
+  // Run a queued task in the calling thread, if any
+  bool runPending();
+
+  static ThreadPool& getDefault();
+
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex lock;
+  std::condition_variable ready;
+  bool stopping;
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator =(const ThreadPool&) = delete;
+
+  void submit(std::function<void()>&&);
+  void work();
+
+}; // ThreadPool
+
+} // end namespace System
+
+#endif // __ThreadPool_h
@@ -0,0 +1,99 @@
+#ifndef __TiledImage_h
+#define __TiledImage_h
+
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TiledImage.h
+//  ========
+//  Class definition for memory-mapped tiled image.
+
+#include <vector>
+#include "Image.h"
+#include "MappedFile.h"
+
+namespace Graphics
+{ // begin namespace Graphics
+
+// Default width and height of a tile, in pixels
+#define TILED_IMAGE_TILE_SIZE 64
+
+
+//////////////////////////////////////////////////////////
+//
+// TiledImage: memory-mapped tiled image class
+// ==========
+//
+// Image written straight into a memory-mapped binary PPM file, for
+// frames larger than memory. The image is divided into square tiles,
+// numbered row by row from the bottom left, that are rendered and
+// written one at a time (see RayTracer::renderTiles()). Once all the
+// tiles of a band (a row of tiles) are written, the band is flushed to
+// the file and its pages are released in one go, as is a written row,
+// so only the band being written is resident, whatever the image size.
+//
+class TiledImage: public Image
+{
+public:
+  // Create an image file, or return 0 if it cannot be created
+  static TiledImage* create(const char*,
+    int,
+    int,
+    int = TILED_IMAGE_TILE_SIZE);
+
+  void getSize(int& w, int& h) const
+  {
+    w = W;
+    h = H;
+  }
+
+  int getTileSize() const
+  {
+    return tileSize;
+  }
+
+  int getNumberOfTiles() const
+  {
+    return tilesX * tilesY;
+  }
+
+  // Bounds of a tile: origin and size, clipped to the image
+  void getTile(int, int&, int&, int&, int&) const;
+
+  void write(int, Pixel[]);
+  // Write the pixels of a tile, row by row from its bottom
+  void writeTile(int, const Pixel[]);
+
+private:
+  System::MappedFile file;
+  size_t offset; // of the first row
+  int W;
+  int H;
+  int tileSize;
+  int tilesX;
+  int tilesY;
+  std::vector<int> tilesWritten; // per band
+
+  // Constructor
+  TiledImage(int, int, int);
+
+  // Offset of pixel (i, j), counted from the bottom left
+  size_t pixelOffset(int i, int j) const
+  {
+    return offset + ((size_t)(H - 1 - j) * W + i) * sizeof(Pixel);
+  }
+
+  void release(size_t, size_t);
+
+}; // TiledImage
+
+} // end namespace Graphics
+
+#endif // __TiledImage_h
@@ -15,6 +15,8 @@
 //  ========
 //  Class definition for simple triangle mesh.
 
+#include <atomic>
+#include <mutex>
 #include "Geometry/Bounds3.h"
 #include "Graphics/Color.h"
 #include "Object.h"
@@ -152,7 +154,8 @@ public:
   // Constructor
   TriangleMesh(const Arrays& a):
     id(++nextId),
-    data(a)
+    data(a),
+    boundsValid(false)
   {
     // do nothing
   }
@@ -160,18 +163,29 @@ public:
   // Destructor
   ~TriangleMesh()
   {
-    delete data.vertices;
-    delete data.normals;
-    delete data.vertexColors;
-    delete data.triangles;
+    delete []data.vertices;
+    delete []data.normals;
+    delete []data.vertexColors;
+    delete []data.triangles;
   }
 
   Object* clone() const;
-  Bounds3 boundingBox() const;
+
+  // Bounds are computed once and kept until the mesh is transformed
+  Bounds3 boundingBox() const
+  {
+    if (!boundsValid.load(std::memory_order_acquire))
+      computeBounds();
+    return bounds;
+  }
 
   void computeNormals();
   void transform(const mat4&);
 
+  // Weld duplicate vertices, drop degenerate triangles and reorder
+  // triangles and vertices for locality; the mesh must own its arrays
+  void optimize();
+
   const Arrays& getData() const
   {
     return data;
@@ -191,7 +205,14 @@ protected:
   Arrays data;
 
 private:
-  static uint nextId;
+  mutable Bounds3 bounds;
+  mutable std::atomic<bool> boundsValid;
+  mutable std::mutex boundsLock;
+
+  // Meshes can be made by concurrent tasks
+  static std::atomic<uint> nextId;
+
+  void computeBounds() const;
 
 }; // TriangleMesh
 
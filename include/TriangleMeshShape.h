@@ -21,6 +21,58 @@
 namespace Graphics
 { // begin namespace Graphics
 
+//
+// Auxiliary functions
+//
+// Intersects a ray with triangle p0 p1 p2 (Moller-Trumbore); on a hit,
+// sets the distance and the barycentric coordinates u and v of hit
+inline bool
+intersectTriangle(const vec3& p0,
+  const vec3& p1,
+  const vec3& p2,
+  const Ray& ray,
+  Intersection& hit)
+{
+  vec3 e1 = p1 - p0;
+  vec3 e2 = p2 - p0;
+  vec3 s1 = ray.direction.cross(e2);
+  REAL invDet = s1.dot(e1);
+
+  if (Math::isZero(invDet))
+    return false;
+  invDet = Math::inverse(invDet);
+
+  // Compute first barycentric coordinate
+  vec3 s = ray.origin - p0;
+  REAL b1 = s.dot(s1) * invDet;
+
+  if (b1 < 0 || b1 > 1)
+    return false;
+
+  // Compute second barycentric coordinate
+  vec3 s2 = s.cross(e1);
+  REAL b2 = ray.direction.dot(s2) * invDet;
+
+  if (b2 < 0 || b1 + b2 > 1)
+    return false;
+
+  // Compute distance to the intersection point
+  REAL t = e2.dot(s2) * invDet;
+
+  if (t < ray.minD || t > ray.maxD)
+    return false;
+  hit.distance = t;
+  hit.u = b1;
+  hit.v = b2;
+  return true;
+}
+
+// Bounds of the part of triangle p0 p1 p2 inside a box
+Bounds3 clippedTriangleBounds(const vec3&,
+  const vec3&,
+  const vec3&,
+  const Bounds3&);
+
 
 //////////////////////////////////////////////////////////
 //
@@ -45,7 +97,7 @@ public:
   Object* clone() const;
 
   bool canIntersect() const;
-  Array<ModelPtr> refine() const;
+  Array<ModelPtr> refine(Arena* = 0) const;
   const TriangleMesh* triangleMesh() const;
   bool intersect(const Ray&, Intersection&) const;
   vec3 normal(const Intersection&) const;
@@ -76,6 +128,7 @@ public:
   vec3 normal(const Intersection&) const;
   const Material* getMaterial() const;
   Bounds3 boundingBox() const;
+  Bounds3 clippedBoundingBox(const Bounds3&) const;
 
 private:
   ObjectPtr<TriangleMesh> mesh;
@@ -0,0 +1,129 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: AccumulationBuffer.cpp
+//  ========
+//  Source file for HDR accumulation buffer.
+
+#include "AccumulationBuffer.h"
+
+using namespace Graphics;
+
+inline float
+clampUnit(float x)
+{
+  return x < 0 ? 0 : x > 1 ? 1 : x;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// AccumulationBuffer implementation
+// ==================
+void
+AccumulationBuffer::resize(int w, int h)
+//[]---------------------------------------------------[]
+//|  Resize                                             |
+//[]---------------------------------------------------[]
+{
+  if (w == W && h == H)
+    return;
+  W = w;
+  H = h;
+  sums.assign(W * H, Color(0.0f, 0.0f, 0.0f));
+  counts.assign(W * H, 0);
+}
+
+void
+AccumulationBuffer::clear()
+//[]---------------------------------------------------[]
+//|  Clear                                              |
+//[]---------------------------------------------------[]
+{
+  sums.assign(W * H, Color(0.0f, 0.0f, 0.0f));
+  counts.assign(W * H, 0);
+}
+
+Color
+AccumulationBuffer::getColor(int i, int j) const
+//[]---------------------------------------------------[]
+//|  Get color                                          |
+//[]---------------------------------------------------[]
+{
+  int k = j * W + i;
+
+  if (counts[k] == 0)
+    return Color(0.0f, 0.0f, 0.0f);
+  return sums[k] * (1.0f / counts[k]);
+}
+
+Color
+AccumulationBuffer::getToneMappedColor(int i, int j) const
+//[]---------------------------------------------------[]
+//|  Get tone mapped color                              |
+//[]---------------------------------------------------[]
+{
+  Color c = getColor(i, j) * exposure;
+
+  if (toneMapping == Reinhard)
+    for (int k = 0; k < 3; k++)
+      c[k] = c[k] > 0 ? c[k] / (1 + c[k]) : 0;
+  else
+    for (int k = 0; k < 3; k++)
+      c[k] = clampUnit(c[k]);
+  return c;
+}
+
+void
+AccumulationBuffer::write(Image& image) const
+//[]---------------------------------------------------[]
+//|  Write                                              |
+//[]---------------------------------------------------[]
+{
+  int w, h;
+
+  image.getSize(w, h);
+  if (image.isTopDown())
+    for (int j = h; --j >= 0;)
+      write(image, j);
+  else
+    for (int j = 0; j < h; j++)
+      write(image, j);
+}
+
+void
+AccumulationBuffer::write(Image& image, int j) const
+//[]---------------------------------------------------[]
+//|  Write row                                          |
+//|  Only the pixels of the row inside both the buffer  |
+//|  and the image come from the buffer                 |
+//[]---------------------------------------------------[]
+{
+  int w, h;
+
+  image.getSize(w, h);
+  if (j < 0 || j >= h)
+    return;
+
+  int n = j < H ? dMin(w, W) : 0;
+
+  if (image.isHDR())
+  {
+    colorRow.assign(w, Color(0.0f, 0.0f, 0.0f));
+    for (int i = 0; i < n; i++)
+      colorRow[i] = getColor(i, j) * exposure;
+    image.writeHDR(j, colorRow.data());
+    return;
+  }
+  pixelRow.assign(w, Pixel(0, 0, 0));
+  for (int i = 0; i < n; i++)
+    pixelRow[i] = getToneMappedColor(i, j);
+  image.write(j, pixelRow.data());
+}
@@ -0,0 +1,379 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: AnalyticShape.cpp
+//  ========
+//  Source file for analytic shape.
+
+#include <algorithm>
+#include <math.h>
+#include "AnalyticShape.h"
+
+using namespace Graphics;
+
+//
+// The unit shapes below live in the local space of the canonical
+// meshes and get rays transformed by a ModelInstance. Directions are
+// not normalized, so a distance is also the parameter of the ray. A
+// hit keeps in u, v and primitive just enough to get the normal
+//
+
+// Keeps t in hit if it is the closest distance in the ray so far
+inline bool
+closer(REAL t, const Ray& ray, Intersection& hit)
+{
+  // Written so that a NaN is never closer
+  if (!(t >= ray.minD && t <= hit.distance))
+    return false;
+  hit.distance = t;
+  return true;
+}
+
+// Returns true if x, of the order of the length l of a direction, is
+// negligible relative to it. Directions are not normalized, and their
+// lengths are the inverse of the scales of the instances
+inline bool
+isNegligible(REAL x, REAL l)
+{
+  return Math::isZero(x, FloatInfo<REAL>::eps() * l);
+}
+
+// Gets the roots t0 <= t1 of a t^2 + 2 b t + c = 0, where a is of the
+// order of dd, the squared length of the direction of the ray, and b
+// of the order of its length
+inline bool
+solveQuadratic(REAL a, REAL b, REAL c, REAL dd, REAL& t0, REAL& t1)
+{
+  if (isNegligible(a, dd))
+  {
+    if (isNegligible(b, sqrt(dd)))
+      return false;
+    t0 = t1 = -c / (2 * b);
+    return true;
+  }
+
+  REAL d = b * b - a * c;
+
+  if (d < 0)
+    return false;
+  d = sqrt(d);
+  // Avoid the cancellation of -b + d (or -b - d)
+  REAL q = b < 0 ? d - b : -d - b;
+
+  t0 = q / a;
+  t1 = c / q;
+  if (t0 > t1)
+    std::swap(t0, t1);
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// UnitShape: unit shape class
+// =========
+class UnitShape: public Model
+{
+public:
+  const Material* getMaterial() const
+  {
+    System::warning("UnitShape::getMaterial() invoked");
+    return 0;
+  }
+
+}; // UnitShape
+
+
+//////////////////////////////////////////////////////////
+//
+// UnitSphere: sphere of radius 1 centered at the origin
+// ==========
+class UnitSphere: public UnitShape
+{
+public:
+  bool intersect(const Ray& ray, Intersection& hit) const
+  {
+    const vec3& o = ray.origin;
+    const vec3& d = ray.direction;
+    REAL dd = d.dot(d);
+    REAL t0;
+    REAL t1;
+
+    // a = dd is never negligible, so the equation is always quadratic
+    if (!solveQuadratic(dd, o.dot(d), o.dot(o) - 1, dd, t0, t1))
+      return false;
+    hit.distance = ray.maxD;
+    if (!closer(t0, ray, hit) && !closer(t1, ray, hit))
+      return false;
+
+    // Keep the two smallest coordinates of the point; the largest
+    // one is recomputed, well conditioned, from them
+    vec3 p = ray(hit.distance);
+    vec3 a(fabs(p.x), fabs(p.y), fabs(p.z));
+    int k = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+
+    hit.u = p[(k + 1) % 3];
+    hit.v = p[(k + 2) % 3];
+    hit.primitive = k << 1 | (p[k] < 0);
+    return true;
+  }
+
+  vec3 normal(const Intersection& hit) const
+  {
+    int k = hit.primitive >> 1;
+    REAL w = sqrt(std::max<REAL>(0, 1 - hit.u * hit.u - hit.v * hit.v));
+    vec3 N;
+
+    N[k] = hit.primitive & 1 ? -w : w;
+    N[(k + 1) % 3] = hit.u;
+    N[(k + 2) % 3] = hit.v;
+    return N.versor();
+  }
+
+  Bounds3 boundingBox() const
+  {
+    return Bounds3(vec3(-1, -1, -1), vec3(1, 1, 1));
+  }
+
+}; // UnitSphere
+
+
+//////////////////////////////////////////////////////////
+//
+// UnitBox: box with corners (-1,-1,-1) and (1,1,1)
+// =======
+class UnitBox: public UnitShape
+{
+public:
+  bool intersect(const Ray& ray, Intersection& hit) const
+  {
+    REAL tNear = -FloatInfo<REAL>::inf();
+    REAL tFar = +FloatInfo<REAL>::inf();
+    int kNear = 0;
+    int kFar = 0;
+
+    // Slabs
+    for (int k = 0; k < 3; k++)
+    {
+      REAL invD = 1 / ray.direction[k];
+      REAL t0 = (-1 - ray.origin[k]) * invD;
+      REAL t1 = (+1 - ray.origin[k]) * invD;
+
+      if (t0 > t1)
+        std::swap(t0, t1);
+      if (t0 > tNear)
+        tNear = t0, kNear = k;
+      if (t1 < tFar)
+        tFar = t1, kFar = k;
+    }
+    if (tNear > tFar)
+      return false;
+    hit.distance = ray.maxD;
+
+    int k;
+
+    if (closer(tNear, ray, hit))
+      k = kNear;
+    else if (closer(tFar, ray, hit))
+      k = kFar;
+    else
+      return false;
+    hit.primitive = k << 1 | (ray(hit.distance)[k] < 0);
+    return true;
+  }
+
+  vec3 normal(const Intersection& hit) const
+  {
+    vec3 N = vec3::null();
+
+    N[hit.primitive >> 1] = hit.primitive & 1 ? -1 : 1;
+    return N;
+  }
+
+  Bounds3 boundingBox() const
+  {
+    return Bounds3(vec3(-1, -1, -1), vec3(1, 1, 1));
+  }
+
+}; // UnitBox
+
+
+//////////////////////////////////////////////////////////
+//
+// UnitCylinder: cylinder of radius 1 and height 1 along the y axis,
+// ============  centered at the origin
+class UnitCylinder: public UnitShape
+{
+public:
+  bool intersect(const Ray& ray, Intersection& hit) const
+  {
+    const vec3& o = ray.origin;
+    const vec3& d = ray.direction;
+    REAL dd = d.dot(d);
+    REAL t[2];
+
+    hit.distance = ray.maxD;
+    hit.primitive = -1;
+    // Side
+    if (solveQuadratic(d.x * d.x + d.z * d.z,
+      o.x * d.x + o.z * d.z,
+      o.x * o.x + o.z * o.z - 1,
+      dd,
+      t[0],
+      t[1]))
+      for (int i = 0; i < 2; i++)
+        if (fabs(o.y + t[i] * d.y) <= REAL(0.5) && closer(t[i], ray, hit))
+        {
+          hit.primitive = 0;
+          break;
+        }
+    // Caps: 1 is the top, 2 the bottom
+    if (!isNegligible(d.y, sqrt(dd)))
+      for (int i = 1; i <= 2; i++)
+      {
+        REAL s = (i == 1 ? REAL(0.5) : REAL(-0.5)) - o.y;
+        REAL tc = s / d.y;
+        REAL x = o.x + tc * d.x;
+        REAL z = o.z + tc * d.z;
+
+        if (x * x + z * z <= 1 && closer(tc, ray, hit))
+          hit.primitive = i;
+      }
+    if (hit.primitive < 0)
+      return false;
+
+    vec3 p = ray(hit.distance);
+
+    hit.u = p.x;
+    hit.v = p.z;
+    return true;
+  }
+
+  vec3 normal(const Intersection& hit) const
+  {
+    if (hit.primitive != 0)
+      return vec3(0, hit.primitive == 1 ? 1 : -1, 0);
+    return vec3(hit.u, 0, hit.v).versor();
+  }
+
+  Bounds3 boundingBox() const
+  {
+    return Bounds3(vec3(-1, -0.5, -1), vec3(1, 0.5, 1));
+  }
+
+}; // UnitCylinder
+
+
+//////////////////////////////////////////////////////////
+//
+// UnitCone: cone of radius 1 and height 1 along the y axis, with
+// ========  base centered at the origin
+class UnitCone: public UnitShape
+{
+public:
+  bool intersect(const Ray& ray, Intersection& hit) const
+  {
+    const vec3& o = ray.origin;
+    const vec3& d = ray.direction;
+    // The side is x^2 + z^2 = h^2, with h = 1 - y
+    REAL h = 1 - o.y;
+    REAL dd = d.dot(d);
+    REAL t[2];
+
+    hit.distance = ray.maxD;
+    hit.primitive = -1;
+    // Side
+    if (solveQuadratic(d.x * d.x + d.z * d.z - d.y * d.y,
+      o.x * d.x + o.z * d.z + h * d.y,
+      o.x * o.x + o.z * o.z - h * h,
+      dd,
+      t[0],
+      t[1]))
+      for (int i = 0; i < 2; i++)
+      {
+        REAL y = o.y + t[i] * d.y;
+
+        if (y >= 0 && y <= 1 && closer(t[i], ray, hit))
+        {
+          hit.primitive = 0;
+          break;
+        }
+      }
+    // Base
+    if (!isNegligible(d.y, sqrt(dd)))
+    {
+      REAL tb = -o.y / d.y;
+      REAL x = o.x + tb * d.x;
+      REAL z = o.z + tb * d.z;
+
+      if (x * x + z * z <= 1 && closer(tb, ray, hit))
+        hit.primitive = 1;
+    }
+    if (hit.primitive < 0)
+      return false;
+
+    vec3 p = ray(hit.distance);
+
+    hit.u = p.x;
+    hit.v = p.z;
+    return true;
+  }
+
+  vec3 normal(const Intersection& hit) const
+  {
+    if (hit.primitive != 0)
+      return vec3(0, -1, 0);
+
+    // The side makes 45 degrees with the axis
+    REAL r = sqrt(hit.u * hit.u + hit.v * hit.v);
+
+    if (Math::isZero(r))
+      return vec3::up();
+    return vec3(hit.u / r, 1, hit.v / r).versor();
+  }
+
+  Bounds3 boundingBox() const
+  {
+    return Bounds3(vec3(-1, 0, -1), vec3(1, 1, 1));
+  }
+
+}; // UnitCone
+
+
+//////////////////////////////////////////////////////////
+//
+// AnalyticShape implementation
+// =============
+Object*
+AnalyticShape::clone() const
+//[]---------------------------------------------------[]
+//|  Make copy                                          |
+//|  The canonical mesh is shared, not copied           |
+//[]---------------------------------------------------[]
+{
+  return new AnalyticShape(type, (TriangleMesh*)getMesh());
+}
+
+Model*
+AnalyticShape::getShape() const
+//[]---------------------------------------------------[]
+//|  Get shape                                          |
+//[]---------------------------------------------------[]
+{
+  static ModelPtr shapes[] =
+  {
+    new UnitSphere(),
+    new UnitBox(),
+    new UnitCylinder(),
+    new UnitCone()
+  };
+
+  return shapes[type];
+}
@@ -0,0 +1,170 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: Arena.cpp
+//  ========
+//  Source file for memory arena.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include "Arena.h"
+#include "Exception.h"
+
+using namespace System;
+
+static void*
+mapMemory(size_t size)
+{
+  void* p;
+
+#ifdef _WIN32
+  // Large pages require the lock memory privilege; fall back to
+  // normal pages when they cannot be had
+  SIZE_T pageSize = GetLargePageMinimum();
+
+  if (pageSize != 0 && size % pageSize == 0)
+  {
+    p = VirtualAlloc(0,
+      size,
+      MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+      PAGE_READWRITE);
+    if (p != 0)
+      return p;
+  }
+  p = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+  p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    p = 0;
+#ifdef MADV_HUGEPAGE
+  else
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+#endif
+  return p;
+}
+
+static void
+unmapMemory(void* p, size_t size)
+{
+#ifdef _WIN32
+  (void)size;
+  VirtualFree(p, 0, MEM_RELEASE);
+#else
+  munmap(p, size);
+#endif
+}
+
+inline size_t
+roundUp(size_t size, size_t alignment)
+{
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// Arena implementation
+// =====
+Arena::Arena(size_t blockSize):
+  blockSize(blockSize),
+  blocks(0),
+  top(0),
+  end(0),
+  finalizers(0),
+  allocated(0),
+  reserved(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+void*
+Arena::allocate(size_t size, size_t alignment)
+//[]---------------------------------------------------[]
+//|  Allocate                                           |
+//|  Alignment must be a power of two                   |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+  char* p = (char*)roundUp((size_t)top, alignment);
+
+  if (top == 0 || p + size > end)
+  {
+    addBlock(size + alignment);
+    p = (char*)roundUp((size_t)top, alignment);
+  }
+  top = p + size;
+  allocated += size;
+  return p;
+}
+
+void
+Arena::addBlock(size_t minSize)
+//[]---------------------------------------------------[]
+//|  Add block                                          |
+//[]---------------------------------------------------[]
+{
+  size_t header = roundUp(sizeof(Block), 64);
+  size_t size = (minSize + header + blockSize - 1) / blockSize * blockSize;
+  Block* block = (Block*)mapMemory(size);
+
+  if (block == 0)
+    throw Exception("Arena::addBlock(): out of memory");
+  block->next = blocks;
+  block->size = size;
+  blocks = block;
+  top = (char*)block + header;
+  end = (char*)block + size;
+  reserved += size;
+}
+
+void
+Arena::addFinalizer(void* data, int count, void (*destroy)(void*, int))
+//[]---------------------------------------------------[]
+//|  Add finalizer                                      |
+//[]---------------------------------------------------[]
+{
+  Finalizer* f = allocate<Finalizer>(1);
+  std::lock_guard<std::mutex> guard(lock);
+
+  f->next = finalizers;
+  f->destroy = destroy;
+  f->data = data;
+  f->count = count;
+  finalizers = f;
+}
+
+void
+Arena::clear()
+//[]---------------------------------------------------[]
+//|  Clear                                              |
+//|  Destroys the owned objects, in reverse order of    |
+//|  registration, and gives all blocks back            |
+//[]---------------------------------------------------[]
+{
+  for (Finalizer* f = finalizers; f != 0; f = f->next)
+    f->destroy(f->data, f->count);
+  finalizers = 0;
+  while (blocks != 0)
+  {
+    Block* next = blocks->next;
+
+    unmapMemory(blocks, blocks->size);
+    blocks = next;
+  }
+  top = end = 0;
+  allocated = reserved = 0;
+}
@@ -12,6 +12,7 @@
 //  ========
 //  Source file for BVH.
 
+#include <vector>
 #include "BVH.h"
 
 inline void
@@ -26,27 +27,517 @@ center(const Model* m)
   return m->boundingBox().center();
 }
 
+static const int32 binDim = 16;
+
+
+//////////////////////////////////////////////////////////
+//
+// SBVHBuilder: spatial split BVH builder class
+// ===========
+//
+// Builds a BVH choosing, at each node, the cheaper (SAH) of the best
+// binned object split and the best binned spatial split. A spatial
+// split may clip a model into both children (reference duplication);
+// the total number of references is bounded by the duplication budget
+// in the options of the BVH. See Stich et al., "Spatial Splits in
+// Bounding Volume Hierarchies", HPG 2009.
+//
+class SBVHBuilder
+{
+public:
+  // Constructor
+  SBVHBuilder(BVH& b):
+    bvh(b),
+    options(b.options)
+  {
+    // do nothing
+  }
+
+  void build();
+
+private:
+  struct Reference
+  {
+    Bounds3 bounds;
+    int32 index;
+
+  }; // Reference
+
+  typedef std::vector<Reference> References;
+
+  struct Split
+  {
+    REAL cost;
+    int32 axis;
+    REAL position;
+    Bounds3 left;
+    Bounds3 right;
+
+    Split():
+      cost(FloatInfo<REAL>::inf())
+    {
+      // do nothing
+    }
+
+  }; // Split
+
+  BVH& bvh;
+  const BVH::Options& options;
+  Array<ModelPtr>* leafModels;
+  int32 maxReferences;
+  int32 numberOfReferences;
+  REAL rootArea;
+
+  void split(int32, References&, int32);
+  void makeLeaf(BVHNode&, const References&);
+  void findObjectSplit(const References&, Split&) const;
+  void findSpatialSplit(const References&, const Bounds3&, Split&) const;
+  void partitionObjects(References&, const Split&,
+    References&, References&) const;
+  void partitionSpatial(References&, const Split&,
+    References&, References&);
+  void splitReference(const Reference&, int32, REAL,
+    Reference&, Reference&) const;
+
+}; // SBVHBuilder
+
+inline bool
+isNull(const Bounds3& b)
+{
+  // Unlike Bounds3::isEmpty(), flat boxes are not null
+  return b.getMin().x > b.getMax().x;
+}
+
+inline void
+inflate(Bounds3& b, const Bounds3& c)
+{
+  // Inflating by a null box would push the bounds to infinity
+  if (!isNull(c))
+    b.inflate(c);
+}
+
+inline REAL
+boundsArea(const Bounds3& b)
+{
+  return isNull(b) ? FloatInfo<REAL>::inf() : b.area();
+}
+
+void
+SBVHBuilder::build()
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  Array<ModelPtr>& models = bvh.models;
+  int32 n = models.size();
+  References refs(n);
+  Bounds3 root;
+
+  for (int32 i = 0; i < n; i++)
+  {
+    refs[i].bounds = models[i]->boundingBox();
+    refs[i].index = i;
+    inflate(root, refs[i].bounds);
+  }
+  rootArea = root.area();
+  numberOfReferences = n;
+  maxReferences = n + (int32)(n * options.duplicationBudget);
+
+  // Every leaf has at least one reference
+  Array<ModelPtr> output(maxReferences);
+
+  leafModels = &output;
+  bvh.allocateNodes(2 * maxReferences);
+  bvh.numberOfNodes = 1;
+  split(0, refs, 0);
+  models = std::move(output);
+}
+
+void
+SBVHBuilder::makeLeaf(BVHNode& node, const References& refs)
+//[]---------------------------------------------------[]
+//|  Make leaf                                          |
+//[]---------------------------------------------------[]
+{
+  int32 begin = leafModels->size();
+
+  for (const Reference& ref : refs)
+    leafModels->add(bvh.models[ref.index]);
+  node.begin(begin);
+  node.end(leafModels->size() - 1);
+}
+
+void
+SBVHBuilder::split(int32 id, References& refs, int32 level)
+//[]---------------------------------------------------[]
+//|  Split                                              |
+//[]---------------------------------------------------[]
+{
+  BVHNode& node = bvh.nodes[id];
+  Bounds3 bounds;
+
+  for (const Reference& ref : refs)
+    inflate(bounds, ref.bounds);
+  static_cast<Bounds3&>(node) = bounds;
+
+  int32 n = (int32)refs.size();
+
+  if (n <= options.maxLeafSize || level == bvh.maxLevel)
+  {
+    makeLeaf(node, refs);
+    return;
+  }
+
+  Split object;
+  Split spatial;
+
+  findObjectSplit(refs, object);
+  // Try spatial splits only if the children of the object split
+  // overlap and there is room for more references
+  if (numberOfReferences < maxReferences &&
+    BVHStatistics::overlapArea(object.left, object.right) > options.splitAlpha * rootArea)
+    findSpatialSplit(refs, bounds, spatial);
+
+  References left;
+  References right;
+
+  if (spatial.cost < object.cost)
+    partitionSpatial(refs, spatial, left, right);
+  if (left.empty() || right.empty())
+  {
+    left.clear();
+    right.clear();
+    partitionObjects(refs, object, left, right);
+  }
+  // Release the memory of the parent references before descending
+  References().swap(refs);
+
+  int32 lChild = bvh.numberOfNodes++;
+  int32 rChild = bvh.numberOfNodes++;
+
+  node.lChild(lChild);
+  node.rChild(rChild);
+  level++;
+  split(lChild, left, level);
+  split(rChild, right, level);
+}
+
+void
+SBVHBuilder::findObjectSplit(const References& refs, Split& best) const
+//[]---------------------------------------------------[]
+//|  Find object split                                  |
+//|  Binned SAH over the centroids of the references    |
+//[]---------------------------------------------------[]
+{
+  Bounds3 centroids;
+
+  for (const Reference& ref : refs)
+    centroids.inflate(ref.bounds.center());
+  for (int32 axis = 0; axis < 3; axis++)
+  {
+    REAL fPlane = centroids.getMin()[axis];
+    REAL lPlane = centroids.getMax()[axis];
+
+    if (Math::isZero(lPlane - fPlane))
+      continue;
+
+    REAL k = binDim * (1.0f - 1e-6f) / (lPlane - fPlane);
+    Bounds3 binBounds[binDim];
+    int32 binSize[binDim] = {0};
+
+    for (const Reference& ref : refs)
+    {
+      int32 bid = (int32)(k * (ref.bounds.center()[axis] - fPlane));
+
+      bid = dMin(dMax(bid, 0), binDim - 1);
+      inflate(binBounds[bid], ref.bounds);
+      binSize[bid]++;
+    }
+
+    Bounds3 right[binDim];
+    Bounds3 temp;
+
+    for (int32 i = binDim - 1; i > 0; i--)
+    {
+      inflate(temp, binBounds[i]);
+      right[i] = temp;
+    }
+    temp.setEmpty();
+
+    int32 numberOfLeft = 0;
+    int32 n = (int32)refs.size();
+
+    for (int32 i = 0; i < binDim - 1; i++)
+    {
+      inflate(temp, binBounds[i]);
+      if ((numberOfLeft += binSize[i]) == 0 || numberOfLeft == n)
+        continue;
+
+      REAL cost = temp.area() * numberOfLeft +
+        right[i + 1].area() * (n - numberOfLeft);
+
+      if (cost < best.cost)
+      {
+        best.cost = cost;
+        best.axis = axis;
+        best.position = fPlane + (i + 1) / k;
+        best.left = temp;
+        best.right = right[i + 1];
+      }
+    }
+  }
+}
+
+void
+SBVHBuilder::findSpatialSplit(const References& refs,
+  const Bounds3& bounds,
+  Split& best) const
+//[]---------------------------------------------------[]
+//|  Find spatial split                                 |
+//|  Each reference is clipped against the bins it      |
+//|  spans; counts are kept for the bins it enters and  |
+//|  exits                                              |
+//[]---------------------------------------------------[]
+{
+  for (int32 axis = 0; axis < 3; axis++)
+  {
+    REAL origin = bounds.getMin()[axis];
+    REAL width = (bounds.getMax()[axis] - origin) / binDim;
+
+    if (Math::isZero(width))
+      continue;
+
+    REAL invWidth = Math::inverse(width);
+    Bounds3 binBounds[binDim];
+    int32 enter[binDim] = {0};
+    int32 exit[binDim] = {0};
+
+    for (const Reference& ref : refs)
+    {
+      int32 b0 = (int32)((ref.bounds.getMin()[axis] - origin) * invWidth);
+      int32 b1 = (int32)((ref.bounds.getMax()[axis] - origin) * invWidth);
+
+      b0 = dMin(dMax(b0, 0), binDim - 1);
+      b1 = dMin(dMax(b1, b0), binDim - 1);
+      if (b0 == b1)
+        inflate(binBounds[b0], ref.bounds);
+      else
+      {
+        Reference r = ref;
+
+        for (int32 i = b0; i < b1; i++)
+        {
+          Reference lRef;
+          Reference rRef;
+
+          splitReference(r, axis, origin + (i + 1) * width, lRef, rRef);
+          inflate(binBounds[i], lRef.bounds);
+          r = rRef;
+        }
+        inflate(binBounds[b1], r.bounds);
+      }
+      enter[b0]++;
+      exit[b1]++;
+    }
+
+    Bounds3 right[binDim];
+    Bounds3 temp;
+
+    for (int32 i = binDim - 1; i > 0; i--)
+    {
+      inflate(temp, binBounds[i]);
+      right[i] = temp;
+    }
+    temp.setEmpty();
+
+    int32 numberOfLeft = 0;
+    int32 numberOfRight = (int32)refs.size();
+
+    for (int32 i = 0; i < binDim - 1; i++)
+    {
+      inflate(temp, binBounds[i]);
+      numberOfLeft += enter[i];
+      numberOfRight -= exit[i];
+      if (numberOfLeft == 0 || numberOfRight == 0)
+        continue;
+
+      REAL cost = boundsArea(temp) * numberOfLeft +
+        boundsArea(right[i + 1]) * numberOfRight;
+
+      if (cost < best.cost)
+      {
+        best.cost = cost;
+        best.axis = axis;
+        best.position = origin + (i + 1) * width;
+        best.left = temp;
+        best.right = right[i + 1];
+      }
+    }
+  }
+}
+
+void
+SBVHBuilder::splitReference(const Reference& ref,
+  int32 axis,
+  REAL position,
+  Reference& left,
+  Reference& right) const
+//[]---------------------------------------------------[]
+//|  Split reference                                    |
+//[]---------------------------------------------------[]
+{
+  const Model* model = bvh.models[ref.index];
+  vec3 p1 = ref.bounds.getMin();
+  vec3 p2 = ref.bounds.getMax();
+
+  left.index = right.index = ref.index;
+  p2[axis] = position;
+  left.bounds = model->clippedBoundingBox(Bounds3(p1, p2));
+  p1[axis] = position;
+  p2[axis] = ref.bounds.getMax()[axis];
+  right.bounds = model->clippedBoundingBox(Bounds3(p1, p2));
+}
+
+void
+SBVHBuilder::partitionObjects(References& refs,
+  const Split& s,
+  References& left,
+  References& right) const
+//[]---------------------------------------------------[]
+//|  Partition objects                                  |
+//[]---------------------------------------------------[]
+{
+  if (s.cost < FloatInfo<REAL>::inf())
+  {
+    for (const Reference& ref : refs)
+      if (ref.bounds.center()[s.axis] < s.position)
+        left.push_back(ref);
+      else
+        right.push_back(ref);
+    if (!left.empty() && !right.empty())
+      return;
+    left.clear();
+    right.clear();
+  }
+  // All centroids are coincident: split in two halves
+  size_t m = refs.size() / 2;
+
+  left.assign(refs.begin(), refs.begin() + m);
+  right.assign(refs.begin() + m, refs.end());
+}
+
+void
+SBVHBuilder::partitionSpatial(References& refs,
+  const Split& s,
+  References& left,
+  References& right)
+//[]---------------------------------------------------[]
+//|  Partition spatial                                  |
+//|  References straddling the split plane are either   |
+//|  split or, if cheaper, kept whole in one side       |
+//|  (reference unsplitting)                            |
+//[]---------------------------------------------------[]
+{
+  References straddling;
+
+  for (const Reference& ref : refs)
+    if (ref.bounds.getMax()[s.axis] <= s.position)
+      left.push_back(ref);
+    else if (ref.bounds.getMin()[s.axis] >= s.position)
+      right.push_back(ref);
+    else
+      straddling.push_back(ref);
+
+  int32 numberOfLeft = (int32)(left.size() + straddling.size());
+  int32 numberOfRight = (int32)(right.size() + straddling.size());
+
+  for (const Reference& ref : straddling)
+  {
+    Reference lRef;
+    Reference rRef;
+
+    splitReference(ref, s.axis, s.position, lRef, rRef);
+
+    Bounds3 l = s.left;
+    Bounds3 r = s.right;
+
+    inflate(l, ref.bounds);
+    inflate(r, ref.bounds);
+
+    REAL cSplit = boundsArea(s.left) * numberOfLeft +
+      boundsArea(s.right) * numberOfRight;
+    REAL c1 = boundsArea(l) * numberOfLeft +
+      boundsArea(s.right) * (numberOfRight - 1);
+    REAL c2 = boundsArea(s.left) * (numberOfLeft - 1) +
+      boundsArea(r) * numberOfRight;
+
+    if (isNull(lRef.bounds))
+      c2 = -1;
+    else if (isNull(rRef.bounds))
+      c1 = -1;
+    if (c1 < cSplit && c1 <= c2)
+    {
+      left.push_back(ref);
+      numberOfRight--;
+    }
+    else if (c2 < cSplit)
+    {
+      right.push_back(ref);
+      numberOfLeft--;
+    }
+    else if (numberOfReferences < maxReferences)
+    {
+      left.push_back(lRef);
+      right.push_back(rRef);
+      numberOfReferences++;
+    }
+    else if (c1 <= c2)
+    {
+      left.push_back(ref);
+      numberOfRight--;
+    }
+    else
+    {
+      right.push_back(ref);
+      numberOfLeft--;
+    }
+  }
+}
+
 
 //////////////////////////////////////////////////////////
 //
 // BVH implementation
 // ===
-static const int32 binDim = 16;
-static int32* bin;
-static int32* nextBin;
-
-BVH::BVH(Array<ModelPtr>&& m):
-  models(std::move(m))
+// Per thread, as BVHs can be built by concurrent tasks
+static thread_local int32* bin;
+static thread_local int32* nextBin;
+
+BVH::BVH(Array<ModelPtr>&& m, const Options& o, Arena* a):
+  models(std::move(m)),
+  options(o),
+  arena(a)
 //[]---------------------------------------------------[]
 //|  Constructor                                        |
 //[]---------------------------------------------------[]
 {
-  maxLevel = -1;
+  if (options.maxLeafSize < 1)
+    options.maxLeafSize = 1;
+  if (options.maxLevel < 1 || options.maxLevel > BVH_MAX_LEVEL)
+    options.maxLevel = BVH_MAX_LEVEL;
+  maxLevel = options.maxLevel;
+  if (options.duplicationBudget < 0)
+    options.duplicationBudget = 0;
   if (int32 n = models.size())
   {
-    numberOfNodes = 1;
-    nodes = new BVHNode[n << 1];
-    build(nodes[0], 0, n - 1);
+    if (options.spatialSplits)
+      SBVHBuilder(*this).build();
+    else
+    {
+      numberOfNodes = 1;
+      allocateNodes(n << 1);
+      build(nodes[0], 0, n - 1);
+    }
   }
   else
   {
@@ -60,7 +551,8 @@ BVH::~BVH()
 //|  Destructor                                         |
 //[]---------------------------------------------------[]
 {
-  delete nodes;
+  if (arena == 0)
+    delete []nodes;
 }
 
 bool
@@ -72,6 +564,15 @@ BVH::intersect(const Ray& ray, Intersection& hit) const
   return nodes == 0 ? false : intersectBVH(nodes, models, ray, hit);
 }
 
+vec3
+BVH::normal(const Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Normal                                             |
+//[]---------------------------------------------------[]
+{
+  return models[hit.primitive]->normal(hit);
+}
+
 Bounds3
 BVH::boundingBox() const
 //[]---------------------------------------------------[]
@@ -81,6 +582,15 @@ BVH::boundingBox() const
   return nodes == 0 ? Bounds3() : *nodes;
 }
 
+void
+BVH::allocateNodes(int32 n)
+//[]---------------------------------------------------[]
+//|  Allocate nodes                                     |
+//[]---------------------------------------------------[]
+{
+  nodes = arena == 0 ? new BVHNode[n] : arena->newArray<BVHNode>(n);
+}
+
 void
 BVH::build(BVHNode& node, int32 begin, int32 end)
 //[]---------------------------------------------------[]
@@ -94,7 +604,7 @@ BVH::build(BVHNode& node, int32 begin, int32 end)
   bin = new int32[n << 1];
   nextBin = bin + n;
   split(node, 0);
-  delete bin;
+  delete []bin;
 }
 
 void
@@ -109,9 +619,9 @@ BVH::split(BVHNode& node, int32 level)
 
   for (int32 i = begin; i <= end; i++)
     inflate(node, models[i]);
-  if (numberOfModels <= 8)
+  if (numberOfModels <= options.maxLeafSize)
     return;
-  if (maxLevel > 0 && level == maxLevel)
+  if (level == maxLevel)
     return;
 
   vec3 size = node.size();
@@ -259,6 +769,43 @@ BVH::split(BVHNode& node, int32 level)
   split(nodes[rChild], level);
 }
 
+BVHStatistics
+BVH::getStatistics() const
+//[]---------------------------------------------------[]
+//|  Get statistics                                     |
+//[]---------------------------------------------------[]
+{
+  BVHStatistics s;
+
+  if (nodes != 0)
+  {
+    collect(s, 0, 0);
+    s.finish(*nodes);
+  }
+  s.bytes = sizeof(BVH) +
+    numberOfNodes * sizeof(BVHNode) +
+    models.size() * sizeof(ModelPtr);
+  return s;
+}
+
+void
+BVH::collect(BVHStatistics& s, int32 id, int32 depth) const
+//[]---------------------------------------------------[]
+//|  Collect statistics                                 |
+//[]---------------------------------------------------[]
+{
+  const BVHNode& node = nodes[id];
+
+  if (node.lChild() < 0)
+    s.addLeaf(node, node.end() - node.begin() + 1, depth);
+  else
+  {
+    s.addNode(node, nodes[node.lChild()], nodes[node.rChild()], depth);
+    collect(s, node.lChild(), depth + 1);
+    collect(s, node.rChild(), depth + 1);
+  }
+}
+
 void
 BVH::dump(const BVHNode* bvh, int32 id, FILE* file)
 {
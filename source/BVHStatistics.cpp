@@ -0,0 +1,141 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: BVHStatistics.cpp
+//  ========
+//  Source file for BVH statistics.
+
+#include "BVHStatistics.h"
+
+using namespace Graphics;
+
+inline void
+count(std::vector<int>& histogram, int i)
+{
+  if (i >= (int)histogram.size())
+    histogram.resize(i + 1, 0);
+  histogram[i]++;
+}
+
+static void
+printHistogram(FILE* file, const char* name, const std::vector<int>& h)
+{
+  fprintf(file, "  %s:", name);
+  for (int i = 0, n = (int)h.size(); i < n; i++)
+    if (h[i] != 0)
+      fprintf(file, " %d:%d", i, h[i]);
+  fprintf(file, "\n");
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// BVHStatistics implementation
+// =============
+void
+BVHStatistics::reset()
+//[]---------------------------------------------------[]
+//|  Reset                                              |
+//[]---------------------------------------------------[]
+{
+  numberOfNodes = numberOfLeaves = numberOfReferences = maxDepth = 0;
+  sahCost = overlap = 0;
+  bytes = 0;
+  leafSizes.clear();
+  depths.clear();
+  sahArea = overlapAreaSum = 0;
+}
+
+void
+BVHStatistics::addNode(const Bounds3& node,
+  const Bounds3& c1,
+  const Bounds3& c2,
+  int depth)
+//[]---------------------------------------------------[]
+//|  Add interior node                                  |
+//[]---------------------------------------------------[]
+{
+  numberOfNodes++;
+  if (depth > maxDepth)
+    maxDepth = depth;
+  sahArea += traversalCost * node.area();
+  overlapAreaSum += overlapArea(c1, c2);
+}
+
+void
+BVHStatistics::addLeaf(const Bounds3& node, int size, int depth)
+//[]---------------------------------------------------[]
+//|  Add leaf                                           |
+//[]---------------------------------------------------[]
+{
+  numberOfNodes++;
+  numberOfLeaves++;
+  numberOfReferences += size;
+  if (depth > maxDepth)
+    maxDepth = depth;
+  sahArea += intersectionCost * size * node.area();
+  count(leafSizes, size);
+  count(depths, depth);
+}
+
+void
+BVHStatistics::finish(const Bounds3& root)
+//[]---------------------------------------------------[]
+//|  Finish                                             |
+//[]---------------------------------------------------[]
+{
+  REAL a = root.area();
+
+  if (a > 0)
+  {
+    sahCost = sahArea / a;
+    overlap = overlapAreaSum / a;
+  }
+}
+
+void
+BVHStatistics::print(const char* name, FILE* file) const
+//[]---------------------------------------------------[]
+//|  Print                                              |
+//[]---------------------------------------------------[]
+{
+  fprintf(file,
+    "%s: %d nodes, %d leaves, %d refs, depth %d, "
+    "SAH %.3f, overlap %.3f, %.1f KB\n",
+    name != 0 ? name : "BVH",
+    numberOfNodes,
+    numberOfLeaves,
+    numberOfReferences,
+    maxDepth,
+    sahCost,
+    overlap,
+    bytes / 1024.0);
+  printHistogram(file, "leaf sizes", leafSizes);
+  printHistogram(file, "leaf depths", depths);
+}
+
+REAL
+BVHStatistics::overlapArea(const Bounds3& a, const Bounds3& b)
+//[]---------------------------------------------------[]
+//|  Overlap area                                       |
+//|  Surface area of the intersection of two boxes      |
+//[]---------------------------------------------------[]
+{
+  vec3 s;
+
+  for (int i = 0; i < 3; i++)
+  {
+    s[i] = dMin(a.getMax()[i], b.getMax()[i]) -
+      dMax(a.getMin()[i], b.getMin()[i]);
+    if (s[i] <= 0)
+      return 0;
+  }
+  return 2 * (s.x * s.y + s.y * s.z + s.z * s.x);
+}
@@ -0,0 +1,287 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: CompactMesh.cpp
+//  ========
+//  Source file for compact triangle mesh.
+
+#include <math.h>
+#include "CompactMesh.h"
+
+using namespace Graphics;
+
+#define QUANTIZATION_LEVELS 65535
+
+inline REAL
+signNotZero(REAL x)
+{
+  return x < 0 ? REAL(-1) : REAL(1);
+}
+
+inline int16_t
+encodeSnorm(REAL x)
+{
+  return (int16_t)floor(dMin<REAL>(dMax<REAL>(x, -1), 1) * 32767 + REAL(0.5));
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// CompactMesh implementation
+// ===========
+CompactMesh::CompactMesh(const TriangleMesh::Arrays& data):
+  numberOfTriangles(data.numberOfTriangles)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  int nv = data.numberOfVertices;
+
+  for (int i = 0; i < nv; i++)
+    bounds.inflate(data.vertices[i]);
+  origin = bounds.getMin();
+  scale = bounds.size() * Math::inverse<REAL>(QUANTIZATION_LEVELS);
+  positions.resize(3 * nv);
+  for (int i = 0; i < nv; i++)
+    for (int k = 0; k < 3; k++)
+    {
+      REAL x = data.vertices[i][k] - origin[k];
+
+      positions[3 * i + k] = scale[k] == 0 ? 0 :
+        (uint16_t)dMin<REAL>(floor(x / scale[k] + REAL(0.5)),
+          QUANTIZATION_LEVELS);
+    }
+  if (data.normals != 0)
+  {
+    normals.resize(2 * nv);
+    // Octahedral encoding: the unit sphere is projected onto the
+    // octahedron |x| + |y| + |z| = 1, whose lower half is folded over
+    // the upper one, and then onto the z = 0 plane
+    for (int i = 0; i < nv; i++)
+    {
+      const vec3& N = data.normals[i];
+      REAL d = fabs(N.x) + fabs(N.y) + fabs(N.z);
+      REAL x = d > 0 ? N.x / d : 0;
+      REAL y = d > 0 ? N.y / d : 0;
+
+      if (N.z < 0)
+      {
+        REAL t = (1 - fabs(y)) * signNotZero(x);
+
+        y = (1 - fabs(x)) * signNotZero(y);
+        x = t;
+      }
+      normals[2 * i] = encodeSnorm(x);
+      normals[2 * i + 1] = encodeSnorm(y);
+    }
+  }
+
+  int ni = 3 * numberOfTriangles;
+
+  if (nv <= 65536)
+  {
+    shortIndices.resize(ni);
+    for (int i = 0, t = 0; t < numberOfTriangles; t++)
+      for (int k = 0; k < 3; k++)
+        shortIndices[i++] = (uint16_t)data.triangles[t].v[k];
+  }
+  else
+  {
+    indices.resize(ni);
+    for (int i = 0, t = 0; t < numberOfTriangles; t++)
+      for (int k = 0; k < 3; k++)
+        indices[i++] = data.triangles[t].v[k];
+  }
+}
+
+vec3
+CompactMesh::normal(int i) const
+//[]---------------------------------------------------[]
+//|  Normal                                             |
+//[]---------------------------------------------------[]
+{
+  REAL x = normals[2 * i] * Math::inverse<REAL>(32767);
+  REAL y = normals[2 * i + 1] * Math::inverse<REAL>(32767);
+  REAL z = 1 - fabs(x) - fabs(y);
+
+  if (z < 0)
+  {
+    REAL t = (1 - fabs(y)) * signNotZero(x);
+
+    y = (1 - fabs(x)) * signNotZero(y);
+    x = t;
+  }
+  return vec3(x, y, z).versor();
+}
+
+size_t
+CompactMesh::size() const
+//[]---------------------------------------------------[]
+//|  Size                                               |
+//[]---------------------------------------------------[]
+{
+  return positions.size() * sizeof(uint16_t) +
+    normals.size() * sizeof(int16_t) +
+    shortIndices.size() * sizeof(uint16_t) +
+    indices.size() * sizeof(int32_t);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// CompactTriangleShape implementation
+// ====================
+bool
+CompactTriangleShape::intersect(const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Intersect                                          |
+//[]---------------------------------------------------[]
+{
+  int v[3];
+
+  mesh->triangle(index, v);
+  return intersectTriangle(mesh->vertex(v[0]),
+    mesh->vertex(v[1]),
+    mesh->vertex(v[2]),
+    ray,
+    hit);
+}
+
+vec3
+CompactTriangleShape::normal(const Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Normal                                             |
+//[]---------------------------------------------------[]
+{
+  int v[3];
+
+  mesh->triangle(index, v);
+  if (!mesh->hasNormals())
+    return triangleNormal(mesh->vertex(v[0]),
+      mesh->vertex(v[1]),
+      mesh->vertex(v[2]));
+
+  vec3 p(1 - hit.u - hit.v, hit.u, hit.v);
+
+  return triangleInterpolate<vec3>(p,
+    mesh->normal(v[0]),
+    mesh->normal(v[1]),
+    mesh->normal(v[2])).versor();
+}
+
+const Material*
+CompactTriangleShape::getMaterial() const
+//[]---------------------------------------------------[]
+//|  Get material                                       |
+//[]---------------------------------------------------[]
+{
+  System::warning("CompactTriangleShape::getMaterial() invoked");
+  return 0;
+}
+
+Bounds3
+CompactTriangleShape::boundingBox() const
+//[]---------------------------------------------------[]
+//|  Bounding box                                       |
+//[]---------------------------------------------------[]
+{
+  int v[3];
+  Bounds3 b;
+
+  mesh->triangle(index, v);
+  b.inflate(mesh->vertex(v[0]));
+  b.inflate(mesh->vertex(v[1]));
+  b.inflate(mesh->vertex(v[2]));
+  return b;
+}
+
+Bounds3
+CompactTriangleShape::clippedBoundingBox(const Bounds3& box) const
+//[]---------------------------------------------------[]
+//|  Clipped bounding box                               |
+//[]---------------------------------------------------[]
+{
+  int v[3];
+
+  mesh->triangle(index, v);
+  return clippedTriangleBounds(mesh->vertex(v[0]),
+    mesh->vertex(v[1]),
+    mesh->vertex(v[2]),
+    box);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// CompactMeshShape implementation
+// ================
+bool
+CompactMeshShape::canIntersect() const
+//[]---------------------------------------------------[]
+//|  Can intersect                                      |
+//[]---------------------------------------------------[]
+{
+  return false;
+}
+
+Array<ModelPtr>
+CompactMeshShape::refine(Arena* arena) const
+//[]---------------------------------------------------[]
+//|  Refine                                             |
+//|  The triangles are placed in the arena, if any,     |
+//|  which then owns them                               |
+//[]---------------------------------------------------[]
+{
+  int nt = mesh->getNumberOfTriangles();
+  Array<ModelPtr> a(nt);
+
+  if (arena == 0)
+  {
+    for (int t = 0; t < nt; t++)
+      a.add(new CompactTriangleShape(mesh, t));
+    return a;
+  }
+
+  CompactTriangleShape* triangles = arena->allocate<CompactTriangleShape>(nt);
+
+  for (int t = 0; t < nt; t++)
+    a.add(makeUse(new(triangles + t) CompactTriangleShape(mesh, t)));
+  arena->own(triangles, nt);
+  return a;
+}
+
+bool
+CompactMeshShape::intersect(const Ray&, Intersection&) const
+//[]---------------------------------------------------[]
+//|  Intersect                                          |
+//[]---------------------------------------------------[]
+{
+  System::warning("CompactMeshShape::intersect() invoked");
+  return false;
+}
+
+vec3
+CompactMeshShape::normal(const Intersection&) const
+//[]---------------------------------------------------[]
+//|  Normal                                             |
+//[]---------------------------------------------------[]
+{
+  System::warning("CompactMeshShape::normal() invoked");
+  return vec3::null();
+}
+
+Bounds3
+CompactMeshShape::boundingBox() const
+//[]---------------------------------------------------[]
+//|  Bounding box                                       |
+//[]---------------------------------------------------[]
+{
+  return Bounds3(mesh->boundingBox(), localToWorld);
+}
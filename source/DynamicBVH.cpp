@@ -0,0 +1,523 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: DynamicBVH.cpp
+//  ========
+//  Source file for dynamic BVH.
+
+#include <algorithm>
+#include <vector>
+#include "DynamicBVH.h"
+
+using namespace Graphics;
+
+//
+// Auxiliary functions
+//
+inline REAL
+area(const vec3& p1, const vec3& p2)
+{
+  vec3 s = p2 - p1;
+  REAL a = s.x * s.y + s.y * s.z + s.z * s.x;
+
+  return a + a;
+}
+
+inline REAL
+unionArea(const Bounds3& a, const Bounds3& b)
+{
+  const vec3& a1 = a.getMin();
+  const vec3& a2 = a.getMax();
+  const vec3& b1 = b.getMin();
+  const vec3& b2 = b.getMax();
+  vec3 p1(dMin(a1.x, b1.x), dMin(a1.y, b1.y), dMin(a1.z, b1.z));
+  vec3 p2(dMax(a2.x, b2.x), dMax(a2.y, b2.y), dMax(a2.z, b2.z));
+
+  return area(p1, p2);
+}
+
+inline void
+setUnion(Bounds3& c, const Bounds3& a, const Bounds3& b)
+{
+  c.setEmpty();
+  c.inflate(a);
+  c.inflate(b);
+}
+
+#define DBVH_STACK_SIZE 64
+
+
+//////////////////////////////////////////////////////////
+//
+// DynamicBVH implementation
+// ==========
+DynamicBVH::DynamicBVH(int32 n):
+  capacity(n > 0 ? n : 16),
+  numberOfNodes(0),
+  numberOfLeaves(0),
+  freeList(-1),
+  root(-1)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  nodes = new Node[capacity];
+}
+
+DynamicBVH::~DynamicBVH()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  for (int32 i = 0; i < numberOfNodes; i++)
+    if (nodes[i].height == 0)
+      System::release(nodes[i].model);
+  delete []nodes;
+}
+
+int32
+DynamicBVH::allocateNode()
+//[]---------------------------------------------------[]
+//|  Allocate node                                      |
+//[]---------------------------------------------------[]
+{
+  int32 id;
+
+  if (freeList != -1)
+  {
+    id = freeList;
+    freeList = nodes[id].parent;
+  }
+  else
+  {
+    if (numberOfNodes == capacity)
+    {
+      Node* temp = new Node[capacity <<= 1];
+
+      std::copy(nodes, nodes + numberOfNodes, temp);
+      delete []nodes;
+      nodes = temp;
+    }
+    id = numberOfNodes++;
+  }
+
+  Node& node = nodes[id];
+
+  node.parent = node.c1 = node.c2 = -1;
+  node.height = 0;
+  node.model = 0;
+  return id;
+}
+
+void
+DynamicBVH::freeNode(int32 id)
+//[]---------------------------------------------------[]
+//|  Free node                                          |
+//[]---------------------------------------------------[]
+{
+  nodes[id].parent = freeList;
+  nodes[id].height = -1;
+  nodes[id].model = 0;
+  freeList = id;
+}
+
+int32
+DynamicBVH::insert(Model* model)
+//[]---------------------------------------------------[]
+//|  Insert                                             |
+//[]---------------------------------------------------[]
+{
+  int32 leaf = allocateNode();
+  Node& node = nodes[leaf];
+
+  node.model = System::makeUse(model);
+  static_cast<Bounds3&>(node) = model->boundingBox();
+  insertLeaf(leaf);
+  numberOfLeaves++;
+  return leaf;
+}
+
+void
+DynamicBVH::remove(int32 proxy)
+//[]---------------------------------------------------[]
+//|  Remove                                             |
+//[]---------------------------------------------------[]
+{
+  removeLeaf(proxy);
+  System::release(nodes[proxy].model);
+  freeNode(proxy);
+  numberOfLeaves--;
+}
+
+void
+DynamicBVH::update(int32 proxy)
+//[]---------------------------------------------------[]
+//|  Update leaf bounds after its model has moved       |
+//[]---------------------------------------------------[]
+{
+  removeLeaf(proxy);
+  static_cast<Bounds3&>(nodes[proxy]) = nodes[proxy].model->boundingBox();
+  insertLeaf(proxy);
+}
+
+void
+DynamicBVH::update(int32 proxy, Model* model)
+//[]---------------------------------------------------[]
+//|  Replace leaf model                                 |
+//[]---------------------------------------------------[]
+{
+  Node& node = nodes[proxy];
+
+  if (node.model != model)
+  {
+    System::makeUse(model);
+    System::release(node.model);
+    node.model = model;
+  }
+  update(proxy);
+}
+
+void
+DynamicBVH::refit(int32 id)
+//[]---------------------------------------------------[]
+//|  Refit node bounds and height from its children     |
+//[]---------------------------------------------------[]
+{
+  Node& node = nodes[id];
+  const Node& n1 = nodes[node.c1];
+  const Node& n2 = nodes[node.c2];
+
+  setUnion(node, n1, n2);
+  node.height = 1 + dMax(n1.height, n2.height);
+}
+
+void
+DynamicBVH::insertLeaf(int32 leaf)
+//[]---------------------------------------------------[]
+//|  Insert leaf                                        |
+//[]---------------------------------------------------[]
+{
+  if (root == -1)
+  {
+    root = leaf;
+    nodes[root].parent = -1;
+    return;
+  }
+
+  // Find the best sibling for the leaf by descending the tree
+  // along the cheapest (SAH) path
+  const Node& box = nodes[leaf];
+  int32 index = root;
+
+  while (!nodes[index].isLeaf())
+  {
+    const Node& node = nodes[index];
+    REAL a = node.area();
+    REAL combinedArea = unionArea(node, box);
+    REAL cost = combinedArea + combinedArea;
+    REAL inheritanceCost = 2 * (combinedArea - a);
+    REAL cost1 = unionArea(nodes[node.c1], box) + inheritanceCost;
+    REAL cost2 = unionArea(nodes[node.c2], box) + inheritanceCost;
+
+    if (!nodes[node.c1].isLeaf())
+      cost1 -= nodes[node.c1].area();
+    if (!nodes[node.c2].isLeaf())
+      cost2 -= nodes[node.c2].area();
+    if (cost < cost1 && cost < cost2)
+      break;
+    index = cost1 < cost2 ? node.c1 : node.c2;
+  }
+
+  int32 sibling = index;
+  int32 oldParent = nodes[sibling].parent;
+  int32 newParent = allocateNode();
+
+  nodes[newParent].parent = oldParent;
+  nodes[newParent].c1 = sibling;
+  nodes[newParent].c2 = leaf;
+  nodes[sibling].parent = newParent;
+  nodes[leaf].parent = newParent;
+  if (oldParent == -1)
+    root = newParent;
+  else if (nodes[oldParent].c1 == sibling)
+    nodes[oldParent].c1 = newParent;
+  else
+    nodes[oldParent].c2 = newParent;
+
+  // Walk back up the tree fixing heights and bounds
+  for (index = newParent; index != -1; index = nodes[index].parent)
+  {
+    index = balance(index);
+    refit(index);
+  }
+}
+
+void
+DynamicBVH::removeLeaf(int32 leaf)
+//[]---------------------------------------------------[]
+//|  Remove leaf                                        |
+//[]---------------------------------------------------[]
+{
+  if (leaf == root)
+  {
+    root = -1;
+    return;
+  }
+
+  int32 parent = nodes[leaf].parent;
+  int32 grandParent = nodes[parent].parent;
+  int32 sibling = nodes[parent].c1 == leaf ?
+    nodes[parent].c2 : nodes[parent].c1;
+
+  freeNode(parent);
+  nodes[sibling].parent = grandParent;
+  if (grandParent == -1)
+  {
+    root = sibling;
+    return;
+  }
+  if (nodes[grandParent].c1 == parent)
+    nodes[grandParent].c1 = sibling;
+  else
+    nodes[grandParent].c2 = sibling;
+  for (int32 index = grandParent; index != -1; index = nodes[index].parent)
+  {
+    index = balance(index);
+    refit(index);
+  }
+}
+
+int32
+DynamicBVH::balance(int32 iA)
+//[]---------------------------------------------------[]
+//|  Balance                                            |
+//|  Performs a left or right rotation if node A is     |
+//|  imbalanced and returns the new subtree root        |
+//[]---------------------------------------------------[]
+{
+  Node* A = nodes + iA;
+
+  if (A->isLeaf() || A->height < 2)
+    return iA;
+
+  int32 iB = A->c1;
+  int32 iC = A->c2;
+  Node* B = nodes + iB;
+  Node* C = nodes + iC;
+  int32 b = C->height - B->height;
+
+  if (b > 1)
+  {
+    // Rotate C up
+    int32 iF = C->c1;
+    int32 iG = C->c2;
+    Node* F = nodes + iF;
+    Node* G = nodes + iG;
+
+    C->c1 = iA;
+    C->parent = A->parent;
+    A->parent = iC;
+    if (C->parent == -1)
+      root = iC;
+    else if (nodes[C->parent].c1 == iA)
+      nodes[C->parent].c1 = iC;
+    else
+      nodes[C->parent].c2 = iC;
+    if (F->height > G->height)
+    {
+      C->c2 = iF;
+      A->c2 = iG;
+      G->parent = iA;
+    }
+    else
+    {
+      C->c2 = iG;
+      A->c2 = iF;
+      F->parent = iA;
+    }
+    refit(iA);
+    refit(iC);
+    return iC;
+  }
+  if (b < -1)
+  {
+    // Rotate B up
+    int32 iD = B->c1;
+    int32 iE = B->c2;
+    Node* D = nodes + iD;
+    Node* E = nodes + iE;
+
+    B->c1 = iA;
+    B->parent = A->parent;
+    A->parent = iB;
+    if (B->parent == -1)
+      root = iB;
+    else if (nodes[B->parent].c1 == iA)
+      nodes[B->parent].c1 = iB;
+    else
+      nodes[B->parent].c2 = iB;
+    if (D->height > E->height)
+    {
+      B->c2 = iD;
+      A->c1 = iE;
+      E->parent = iA;
+    }
+    else
+    {
+      B->c2 = iE;
+      A->c1 = iD;
+      D->parent = iA;
+    }
+    refit(iA);
+    refit(iB);
+    return iB;
+  }
+  return iA;
+}
+
+bool
+DynamicBVH::intersect(const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Intersect                                          |
+//[]---------------------------------------------------[]
+{
+  hit.distance = ray.maxD;
+  hit.instance = -1;
+  if (root == -1)
+    return false;
+
+  struct Entry
+  {
+    int32 node;
+    REAL distance;
+  };
+
+  Bounds3::PreparedRay r(ray);
+  REAL d = 0;
+
+  if (!nodes[root].intersect(r, d) || d >= hit.distance)
+    return false;
+
+  // The stack holds at most height + 1 entries. Rotations keep the
+  // tree shallow, but its height is not strictly bounded: fall back
+  // to the heap for degenerate trees
+  Entry localStack[DBVH_STACK_SIZE];
+  std::vector<Entry> deepStack;
+  Entry* stack = localStack;
+  int32 top = 0;
+
+  if (nodes[root].height >= DBVH_STACK_SIZE)
+  {
+    deepStack.resize(nodes[root].height + 1);
+    stack = &deepStack[0];
+  }
+
+  stack[top++] = {root, d};
+  while (top != 0)
+  {
+    Entry e = stack[--top];
+
+    // a closer hit may have been found since the node was pushed
+    if (e.distance >= hit.distance)
+      continue;
+
+    int32 index = e.node;
+    const Node* node = nodes + index;
+
+    if (node->isLeaf())
+    {
+      // Distances are shared by the scene and the instance spaces,
+      // so the closest hit so far bounds the search in the leaf
+      Ray leafRay(ray);
+      Intersection h;
+
+      leafRay.maxD = hit.distance;
+      if (node->model->intersect(leafRay, h) && h.distance < hit.distance)
+      {
+        hit = h;
+        hit.instance = index;
+      }
+      continue;
+    }
+
+    Entry c1 = {node->c1, 0};
+    Entry c2 = {node->c2, 0};
+    bool enter1 = nodes[c1.node].intersect(r, c1.distance) &&
+      c1.distance < hit.distance;
+    bool enter2 = nodes[c2.node].intersect(r, c2.distance) &&
+      c2.distance < hit.distance;
+
+    if (enter1 && enter2)
+    {
+      if (c2.distance < c1.distance)
+        dSwap(c1, c2);
+      stack[top++] = c2;
+      stack[top++] = c1;
+    }
+    else if (enter1)
+      stack[top++] = c1;
+    else if (enter2)
+      stack[top++] = c2;
+  }
+  return hit.instance >= 0;
+}
+
+vec3
+DynamicBVH::normal(const Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Normal                                             |
+//[]---------------------------------------------------[]
+{
+  return nodes[hit.instance].model->normal(hit);
+}
+
+BVHStatistics
+DynamicBVH::getStatistics() const
+//[]---------------------------------------------------[]
+//|  Get statistics                                     |
+//[]---------------------------------------------------[]
+{
+  BVHStatistics s;
+
+  if (root != -1)
+  {
+    collect(s, root, 0);
+    s.finish(nodes[root]);
+  }
+  s.bytes = sizeof(DynamicBVH) + capacity * sizeof(Node);
+  return s;
+}
+
+void
+DynamicBVH::collect(BVHStatistics& s, int32 id, int32 depth) const
+//[]---------------------------------------------------[]
+//|  Collect statistics                                 |
+//[]---------------------------------------------------[]
+{
+  const Node& node = nodes[id];
+
+  if (node.isLeaf())
+    s.addLeaf(node, 1, depth);
+  else
+  {
+    s.addNode(node, nodes[node.c1], nodes[node.c2], depth);
+    collect(s, node.c1, depth + 1);
+    collect(s, node.c2, depth + 1);
+  }
+}
+
+Bounds3
+DynamicBVH::boundingBox() const
+//[]---------------------------------------------------[]
+//|  Bounding box                                       |
+//[]---------------------------------------------------[]
+{
+  return root == -1 ? Bounds3() : static_cast<const Bounds3&>(nodes[root]);
+}
@@ -12,6 +12,7 @@
 //  ========
 //  Source file for GL gismo drawer.
 
+#include <stddef.h>
 #include "GLGismoDrawer.h"
 #include "MeshSweeper.h"
 
@@ -75,6 +76,37 @@ GLVertexArray::~GLVertexArray()
   glDeleteVertexArrays(1, &vao);
 }
 
+void
+GLVertexArray::render(GLuint instanceBuffer, int first, int n)
+{
+  const GLsizei stride = sizeof(GLInstance);
+  size_t offset = first * sizeof(GLInstance);
+
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  // The instance arrays are enabled only while drawing instances, so
+  // that the other shaders can use the vertex array as well
+  for (int i = 0; i < 4; i++)
+  {
+    size_t o = offset + offsetof(GLInstance, mvMatrix) + i * sizeof(vec4f);
+
+    glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, stride, (void*)o);
+    glVertexAttribDivisor(3 + i, 1);
+    glEnableVertexAttribArray(3 + i);
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    size_t o = offset + offsetof(GLInstance, normalMatrix) + i * sizeof(vec3f);
+
+    glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, stride, (void*)o);
+    glVertexAttribDivisor(7 + i, 1);
+    glEnableVertexAttribArray(7 + i);
+  }
+  glDrawElementsInstanced(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0, n);
+  for (int i = 3; i < 10; i++)
+    glDisableVertexAttribArray(i);
+}
+
 
 //////////////////////////////////////////////////////////
 //
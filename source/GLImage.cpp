@@ -21,13 +21,35 @@ using namespace Graphics;
 // Auxiliary functions
 //
 inline void
-drawPixels(int w, int h, Pixel* buffer)
+drawTexture(GLuint texture)
 {
+  // The texture is drawn by the fixed pipeline
+  if (GLSL::Program* program = GLSL::Program::getCurrent())
+    program->disuse();
+  glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_LIGHTING);
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
   glMatrixMode(GL_PROJECTION);
   glLoadIdentity();
-  gluOrtho2D(0, w, 0, h);
-  glRasterPos2i(0, 0);
-  glDrawPixels(w, h, GL_RGB, GL_UNSIGNED_BYTE, buffer);
+  gluOrtho2D(0, 1, 0, 1);
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  glBegin(GL_QUADS);
+  glTexCoord2f(0, 0);
+  glVertex2f(0, 0);
+  glTexCoord2f(1, 0);
+  glVertex2f(1, 0);
+  glTexCoord2f(1, 1);
+  glVertex2f(1, 1);
+  glTexCoord2f(0, 1);
+  glVertex2f(0, 1);
+  glEnd();
+  glPopMatrix();
+  glPopAttrib();
   glFlush();
 }
 
@@ -59,12 +81,12 @@ createTexture(int w, int h)
 }
 
 inline void
-setTextureData(int w, int h, void* data)
+setTextureRows(int w, int y, int h, const void* data)
 {
   glTexSubImage2D(GL_TEXTURE_2D,
     0,
     0,
-    0,
+    y,
     w,
     h,
     GL_RGB,
@@ -78,12 +100,45 @@ setTextureData(int w, int h, void* data)
 // GLImage implementation
 // =======
 GLImage::GLImage(int w, int h):
-  ImageBuffer(w, h)
+  ImageBuffer(w, h),
+  current(0),
+  dirtyBegin(h),
+  dirtyEnd(0),
+  lockMode(Read)
 //[]----------------------------------------------------[]
 //|  Constructor                                         |
 //[]----------------------------------------------------[]
 {
-  buffer = new Pixel[w * h];
+  GLsizeiptr size = (GLsizeiptr)w * h * sizeof(Pixel);
+
+  texture = createTexture(w, h);
+  frame = new Pixel[w * h];
+  fences[0] = fences[1] = 0;
+  pbo[0] = pbo[1] = 0;
+  staging[0] = staging[1] = 0;
+  if (GLEW_ARB_buffer_storage)
+  {
+    GLbitfield flags = GL_MAP_WRITE_BIT |
+      GL_MAP_PERSISTENT_BIT |
+      GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(2, pbo);
+    for (int i = 0; i < 2; i++)
+    {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[i]);
+      glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, 0, flags);
+      staging[i] = (Pixel*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+        0,
+        size,
+        flags);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (staging[0] == 0 || staging[1] == 0)
+    {
+      glDeleteBuffers(2, pbo);
+      pbo[0] = pbo[1] = 0;
+    }
+  }
 }
 
 GLImage::~GLImage()
@@ -91,16 +146,71 @@ GLImage::~GLImage()
 //|  Destructor                                          |
 //[]----------------------------------------------------[]
 {
-  delete []buffer;
+  if (pbo[0] != 0)
+  {
+    for (int i = 0; i < 2; i++)
+      if (fences[i] != 0)
+        glDeleteSync(fences[i]);
+    // Deleting the buffers unmaps them
+    glDeleteBuffers(2, pbo);
+  }
+  glDeleteTextures(1, &texture);
+  delete []frame;
 }
 
 void
-GLImage::write(int i, Pixel pixels[])
+GLImage::write(int i, Pixel p[])
 //[]----------------------------------------------------[]
 //|  Write                                               |
 //[]----------------------------------------------------[]
 {
-  memcpy(buffer + i * W, pixels, W * sizeof(Pixel));
+  if (i < 0 || i >= H)
+    return;
+  memcpy(frame + i * W, p, W * sizeof(Pixel));
+  dirtyBegin = dMin(dirtyBegin, i);
+  dirtyEnd = dMax(dirtyEnd, i + 1);
+}
+
+void
+GLImage::upload() const
+//[]----------------------------------------------------[]
+//|  Upload                                              |
+//|  Copies the dirty rows to the staging buffer, once   |
+//|  the upload from it, if any, is done, and uploads    |
+//|  them from there                                     |
+//[]----------------------------------------------------[]
+{
+  int y = dirtyBegin;
+  int n = dirtyEnd - dirtyBegin;
+
+  dirtyBegin = H;
+  dirtyEnd = 0;
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (pbo[0] == 0)
+  {
+    setTextureRows(W, y, n, frame + y * W);
+    return;
+  }
+  if (fences[current] != 0)
+  {
+    while (glClientWaitSync(fences[current],
+      GL_SYNC_FLUSH_COMMANDS_BIT,
+      1000000000) == GL_TIMEOUT_EXPIRED)
+      ;
+    glDeleteSync(fences[current]);
+    fences[current] = 0;
+  }
+
+  size_t offset = (size_t)y * W;
+
+  memcpy(staging[current] + offset, frame + offset, n * W * sizeof(Pixel));
+  // the data pointer is an offset into the bound buffer
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[current]);
+  setTextureRows(W, y, n, (void*)(offset * sizeof(Pixel)));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  current ^= 1;
 }
 
 void
@@ -109,23 +219,31 @@ GLImage::draw() const
 //|  Draw                                                |
 //[]----------------------------------------------------[]
 {
-  drawPixels(W, H, buffer);
+  if (dirtyBegin < dirtyEnd)
+    upload();
+  drawTexture(texture);
 }
 
 Pixel*
-GLImage::map(LockMode)
+GLImage::map(LockMode mode)
 //[]----------------------------------------------------[]
 //|  Map                                                 |
 //[]----------------------------------------------------[]
 {
-  return buffer;
+  lockMode = mode;
+  return frame;
 }
 
 void
 GLImage::unmap()
 //[]----------------------------------------------------[]
 //|  Unmap                                               |
+//|  Any pixel may have been written through the lock    |
 //[]----------------------------------------------------[]
 {
-  // do nothing
+  if (lockMode == Write)
+  {
+    dirtyBegin = 0;
+    dirtyEnd = H;
+  }
 }
@@ -12,6 +12,8 @@
 //  ========
 //  Source file for GL renderer.
 
+#include <algorithm>
+#include <functional>
 #include "GLRenderer.h"
 #include "MeshSweeper.h"
 
@@ -28,18 +30,21 @@ static const char* vertexShader = STRINGIFY(
   layout(location = 0) in vec4 position;
   layout(location = 1) in vec3 normal;
   layout(location = 2) in vec4 color;
-  uniform mat4 mvMatrix;
-  uniform mat3 normalMatrix;
-  uniform mat4 mvpMatrix;
+  // per-instance attributes (see GLInstance)
+  layout(location = 3) in mat4 mvMatrix;
+  layout(location = 7) in mat3 normalMatrix;
+  uniform mat4 projectionMatrix;
   out vec3 vPosition;
   out vec3 vNormal;
   out vec4 vColor;
 
   void main()
   {
-    vPosition = vec3(mvMatrix * position);
+    vec4 P = mvMatrix * position;
+
+    vPosition = vec3(P);
     vNormal = normalize(normalMatrix * normal);
-    gl_Position = mvpMatrix * position;
+    gl_Position = projectionMatrix * P;
     vColor = color;
   }
 );
@@ -202,9 +207,7 @@ static const char* fragmentShader = STRINGIFY(
 inline void
 GLRenderer::getUniformLocations()
 {
-  mvMatrixLoc = program.getUniformLocation("mvMatrix");
-  normalMatrixLoc = program.getUniformLocation("normalMatrix");
-  mvpMatrixLoc = program.getUniformLocation("mvpMatrix");
+  projectionMatrixLoc = program.getUniformLocation("projectionMatrix");
   viewportMatrixLoc = program.getUniformLocation("viewportMatrix");
   nbLightsLoc = program.getUniformLocation("nbLights");
   lightLocs[0].position = program.getUniformLocation("lights[0].position");
@@ -253,6 +256,7 @@ GLRenderer::GLRenderer(Scene& scene, Camera* camera):
   program.use();
   getUniformLocations();
   getSubroutineIndices();
+  glGenBuffers(1, &instanceBuffer);
   glEnable(GL_DEPTH_TEST);
 }
 
@@ -307,17 +311,102 @@ GLRenderer::renderLights()
   program.setUniform("nbLights", nl);
 }
 
+//
+// View frustum planes, from a view-projection matrix; a point p is
+// inside a plane (a,b,c,d) if a * p.x + b * p.y + c * p.z + d >= 0
+//
+class ViewFrustum
+{
+public:
+  ViewFrustum(const mat4& m)
+  {
+    // left/right, bottom/top and near/far planes: row 3 of the
+    // matrix plus/minus rows 0, 1 and 2
+    for (int i = 0; i < 3; i++)
+      for (int k = 0; k < 4; k++)
+      {
+        planes[2 * i][k] = m[k][3] + m[k][i];
+        planes[2 * i + 1][k] = m[k][3] - m[k][i];
+      }
+  }
+
+  // False if the box is entirely outside a plane
+  bool intersects(const Bounds3& b) const
+  {
+    const vec3& p1 = b.getMin();
+    const vec3& p2 = b.getMax();
+
+    for (int i = 0; i < 6; i++)
+    {
+      const vec4& p = planes[i];
+      // corner of the box farthest inside the plane
+      vec3 c(p.x >= 0 ? p2.x : p1.x,
+        p.y >= 0 ? p2.y : p1.y,
+        p.z >= 0 ? p2.z : p1.z);
+
+      if (p.x * c.x + p.y * c.y + p.z * c.z + p.w < 0)
+        return false;
+    }
+    return true;
+  }
+
+private:
+  vec4 planes[6];
+
+}; // ViewFrustum
+
+inline bool
+sameBatch(const Model* a, const Model* b)
+{
+  return a->triangleMesh() == b->triangleMesh() &&
+    a->getMaterial() == b->getMaterial();
+}
+
 void
 GLRenderer::renderActors()
 {
+  ViewFrustum frustum(computeVpMatrix(camera));
+
+  visibleModels.clear();
   for (auto ait = scene->getActorIterator(); ait;)
   {
     const Actor* actor = ait++;
 
     if (!actor->isVisible())
       continue;
-    drawMesh(actor->getModel());
+
+    const Model* model = actor->getModel();
+
+    if (model->triangleMesh() != 0 && frustum.intersects(model->boundingBox()))
+      visibleModels.push_back(model);
   }
+  std::sort(visibleModels.begin(),
+    visibleModels.end(),
+    [](const Model* a, const Model* b)
+    {
+      std::less<const void*> less;
+
+      if (a->triangleMesh() != b->triangleMesh())
+        return less(a->triangleMesh(), b->triangleMesh());
+      return less(a->getMaterial(), b->getMaterial());
+    });
+
+  mat4 vm = camera->getWorldToCameraMatrix();
+
+  instances.clear();
+  for (const Model* model : visibleModels)
+    instances.push_back(makeInstance(model, vm));
+  uploadInstances();
+  for (int i = 0, n = (int)visibleModels.size(); i < n;)
+  {
+    int first = i;
+
+    while (++i < n && sameBatch(visibleModels[first], visibleModels[i]))
+      ;
+    drawInstances(visibleModels[first], first, i - first);
+  }
+  for (const Model* model : visibleModels)
+    drawModelGismos(model);
 }
 
 void
@@ -331,6 +420,7 @@ GLRenderer::startRender()
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   program.use();
   program.setUniform(viewportMatrixLoc, viewportMatrix);
+  program.setUniform(projectionMatrixLoc, camera->getProjectionMatrix());
   glPolygonMode(GL_FRONT_AND_BACK, (renderMode != Wireframe) + GL_LINE);
 }
 
@@ -364,34 +454,38 @@ GLRenderer::endRender()
   program.disuse();
 }
 
-inline mat4
-computeMvpMatrix(const mat4& m, Camera* c)
+GLInstance
+GLRenderer::makeInstance(const Model* model, const mat4& vm) const
 {
-  return c->getProjectionMatrix() * m;
+  GLInstance instance;
+
+  instance.mvMatrix = vm * model->getLocalToWorldMatrix();
+  instance.normalMatrix = mat3(vm) *
+    mat3(model->getWorldToLocalMatrix()).transposed();
+  return instance;
 }
 
 void
-GLRenderer::drawMesh(const Model* model)
+GLRenderer::uploadInstances()
+{
+  // New storage for each frame, so that the driver needs not wait for
+  // the draws of the last one
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  glBufferData(GL_ARRAY_BUFFER,
+    instances.size() * sizeof(GLInstance),
+    instances.data(),
+    GL_STREAM_DRAW);
+}
+
+void
+GLRenderer::drawInstances(const Model* model, int first, int n)
 {
   TriangleMesh* mesh = (TriangleMesh*)model->triangleMesh();
 
-  if (mesh == 0)
-    return;
   if (GLVertexArray* a = vertexArray(mesh))
   {
-    if (flags.isSet(DrawActorBounds))
-    {
-      setLineColor(Color(0.2f, 0.2f, 0.2f));
-      drawBoundingBox(model->boundingBox());
-    }
-
     const Material* m = model->getMaterial();
-    const mat4& t = model->getLocalToWorldMatrix();
-    mat4 mvMatrix = camera->getWorldToCameraMatrix() * t;
 
-    program.setUniform(mvMatrixLoc, mvMatrix);
-    program.setUniform(normalMatrixLoc, mat3(mvMatrix));
-    program.setUniform(mvpMatrixLoc, computeMvpMatrix(mvMatrix, camera));
     program.setUniform(OaLoc, m->surface.ambient);
     program.setUniform(OdLoc, m->surface.diffuse);
     program.setUniform(OsLoc, m->surface.spot);
@@ -404,12 +498,36 @@ GLRenderer::drawMesh(const Model* model)
     i[0] = renderMode == HiddenLines ? lineColorMixIdx : noMixIdx;
     i[1] = mesh->hasVertexColors() ? colorMapMaterialIdx : modelMaterialIdx;
     glUniformSubroutinesuiv(GL_FRAGMENT_SHADER, 2, i);
-    a->render();
-    if (flags.isSet(DrawNormals))
-      drawNormals(mesh, t);
-    if (flags.isSet(DrawAxes))
-      drawAxes(t);
+    a->render(instanceBuffer, first, n);
+  }
+}
+
+void
+GLRenderer::drawModelGismos(const Model* model)
+{
+  if (flags.isSet(DrawActorBounds))
+  {
+    setLineColor(Color(0.2f, 0.2f, 0.2f));
+    drawBoundingBox(model->boundingBox());
   }
+
+  const mat4& t = model->getLocalToWorldMatrix();
+
+  if (flags.isSet(DrawNormals))
+    drawNormals((TriangleMesh*)model->triangleMesh(), t);
+  if (flags.isSet(DrawAxes))
+    drawAxes(t);
+}
+
+void
+GLRenderer::drawMesh(const Model* model)
+{
+  if (model->triangleMesh() == 0)
+    return;
+  instances.assign(1, makeInstance(model, camera->getWorldToCameraMatrix()));
+  uploadInstances();
+  drawInstances(model, 0, 1);
+  drawModelGismos(model);
 }
 
 void
@@ -0,0 +1,919 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: ImageWriter.cpp
+//  ========
+//  Source file for streaming image file writer.
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ImageWriter.h"
+
+using namespace Graphics;
+
+// Size of the IDAT chunks of a PNG file
+#define PNG_IDAT_SIZE (1 << 16)
+
+inline bool
+hasExtension(const char* fileName, const char* ext)
+{
+  const char* dot = strrchr(fileName, '.');
+
+  if (dot == 0)
+    return false;
+  while (*++dot != 0 && tolower(*dot) == *ext)
+    ext++;
+  return *dot == 0 && *ext == 0;
+}
+
+inline void
+putUint32(uint8* p, uint32 x)
+{
+  p[0] = (uint8)(x >> 24);
+  p[1] = (uint8)(x >> 16);
+  p[2] = (uint8)(x >> 8);
+  p[3] = (uint8)x;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// ImageWriter::Encoder: image file encoder class
+// ====================
+class ImageWriter::Encoder
+{
+public:
+  // Destructor
+  virtual ~Encoder()
+  {
+    // do nothing
+  }
+
+  // Bytes of a row of a W pixel image
+  virtual int rowSize(int) const = 0;
+  // True if rows are unclamped float RGB; 8 bit RGB otherwise
+  virtual bool isHDR() const = 0;
+  // True if rows must be written from the top down
+  virtual bool isSequential() const = 0;
+
+  virtual bool begin(FILE*, int, int) = 0;
+  virtual bool writeRow(FILE*, int, const uint8*) = 0;
+  virtual bool end(FILE*) = 0;
+
+}; // ImageWriter::Encoder
+
+
+//////////////////////////////////////////////////////////
+//
+// PPMEncoder: binary PPM encoder class
+// ==========
+class PPMEncoder: public ImageWriter::Encoder
+{
+public:
+  int rowSize(int w) const
+  {
+    return 3 * w;
+  }
+
+  bool isHDR() const
+  {
+    return false;
+  }
+
+  bool isSequential() const
+  {
+    return false;
+  }
+
+  bool begin(FILE*, int, int);
+  bool writeRow(FILE*, int, const uint8*);
+  bool end(FILE*);
+
+protected:
+  long offset; // of the first row
+  int W;
+  int H;
+
+}; // PPMEncoder
+
+bool
+PPMEncoder::begin(FILE* file, int w, int h)
+//[]---------------------------------------------------[]
+//|  Begin                                              |
+//|  The file is extended to its final size, so that    |
+//|  rows can be written in any order                   |
+//[]---------------------------------------------------[]
+{
+  W = w;
+  H = h;
+  if (fprintf(file, "P6\n%d %d\n255\n", W, H) < 0)
+    return false;
+  offset = ftell(file);
+  return fseek(file, offset + (long)rowSize(W) * H - 1, SEEK_SET) == 0 &&
+    fputc(0, file) != EOF;
+}
+
+bool
+PPMEncoder::writeRow(FILE* file, int j, const uint8* row)
+//[]---------------------------------------------------[]
+//|  Write row                                          |
+//|  PPM rows go from the top down                      |
+//[]---------------------------------------------------[]
+{
+  int n = rowSize(W);
+
+  return fseek(file, offset + (long)n * (H - 1 - j), SEEK_SET) == 0 &&
+    fwrite(row, 1, n, file) == (size_t)n;
+}
+
+bool
+PPMEncoder::end(FILE* file)
+//[]---------------------------------------------------[]
+//|  End                                                |
+//[]---------------------------------------------------[]
+{
+  return fflush(file) == 0;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// PFMEncoder: PFM encoder class
+// ==========
+class PFMEncoder: public PPMEncoder
+{
+public:
+  int rowSize(int w) const
+  {
+    return 3 * w * (int)sizeof(float);
+  }
+
+  bool isHDR() const
+  {
+    return true;
+  }
+
+  bool begin(FILE*, int, int);
+  bool writeRow(FILE*, int, const uint8*);
+
+}; // PFMEncoder
+
+bool
+PFMEncoder::begin(FILE* file, int w, int h)
+//[]---------------------------------------------------[]
+//|  Begin                                              |
+//|  A negative scale means little endian floats        |
+//[]---------------------------------------------------[]
+{
+  uint16 one = 1;
+  const char* scale = *(uint8*)&one == 1 ? "-1.0" : "1.0";
+
+  W = w;
+  H = h;
+  if (fprintf(file, "PF\n%d %d\n%s\n", W, H, scale) < 0)
+    return false;
+  offset = ftell(file);
+  return fseek(file, offset + (long)rowSize(W) * H - 1, SEEK_SET) == 0 &&
+    fputc(0, file) != EOF;
+}
+
+bool
+PFMEncoder::writeRow(FILE* file, int j, const uint8* row)
+//[]---------------------------------------------------[]
+//|  Write row                                          |
+//|  PFM rows go from the bottom up, as image rows      |
+//[]---------------------------------------------------[]
+{
+  int n = rowSize(W);
+
+  return fseek(file, offset + (long)n * j, SEEK_SET) == 0 &&
+    fwrite(row, 1, n, file) == (size_t)n;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// Deflater: zlib stream compressor class
+// ========
+//
+// Compresses a stream given in pieces into a single deflate block
+// with the fixed Huffman codes, finding matches in the last 32 KB with
+// hash chains, and wraps it in the zlib format.
+//
+class Deflater
+{
+public:
+  // Constructor
+  Deflater();
+
+  // Compress the next bytes of the stream, appending the output
+  void compress(const uint8*, int, std::vector<uint8>&);
+  // End the stream
+  void finish(std::vector<uint8>&);
+
+private:
+  enum
+  {
+    WINDOW_SIZE = 1 << 15,
+    HASH_BITS = 15,
+    MIN_MATCH = 3,
+    MAX_MATCH = 258,
+    MAX_CHAIN = 32
+  };
+
+  std::vector<uint8> window;
+  int64 base; // stream position of window[0]
+  std::vector<int64> head;
+  std::vector<int64> prev;
+  uint64 bits;
+  int count;
+  uint32 adlerA;
+  uint32 adlerB;
+  bool started;
+
+  void putBits(uint32, int, std::vector<uint8>&);
+  void putCode(uint32, int, std::vector<uint8>&);
+  void putSymbol(int, std::vector<uint8>&);
+  void putMatch(int, int, std::vector<uint8>&);
+  void updateAdler(const uint8*, int);
+
+}; // Deflater
+
+static const int lengthBase[] =
+{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const int lengthExtra[] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const int distanceBase[] =
+{
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+  16385, 24577
+};
+
+static const int distanceExtra[] =
+{
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+Deflater::Deflater():
+  base(0),
+  head(1 << HASH_BITS, -1),
+  prev(WINDOW_SIZE, -1),
+  bits(0),
+  count(0),
+  adlerA(1),
+  adlerB(0),
+  started(false)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+void
+Deflater::putBits(uint32 value, int n, std::vector<uint8>& out)
+//[]---------------------------------------------------[]
+//|  Put bits                                           |
+//|  Deflate packs values from the least significant    |
+//|  bit of each byte                                   |
+//[]---------------------------------------------------[]
+{
+  bits |= (uint64)value << count;
+  for (count += n; count >= 8; count -= 8)
+  {
+    out.push_back((uint8)bits);
+    bits >>= 8;
+  }
+}
+
+void
+Deflater::putCode(uint32 code, int n, std::vector<uint8>& out)
+//[]---------------------------------------------------[]
+//|  Put code                                           |
+//|  Huffman codes go from their most significant bit   |
+//[]---------------------------------------------------[]
+{
+  uint32 r = 0;
+
+  for (int i = 0; i < n; i++, code >>= 1)
+    r = (r << 1) | (code & 1);
+  putBits(r, n, out);
+}
+
+void
+Deflater::putSymbol(int s, std::vector<uint8>& out)
+//[]---------------------------------------------------[]
+//|  Put literal/length symbol                          |
+//[]---------------------------------------------------[]
+{
+  if (s < 144)
+    putCode(0x30 + s, 8, out);
+  else if (s < 256)
+    putCode(0x190 + s - 144, 9, out);
+  else if (s < 280)
+    putCode(s - 256, 7, out);
+  else
+    putCode(0xc0 + s - 280, 8, out);
+}
+
+void
+Deflater::putMatch(int length, int distance, std::vector<uint8>& out)
+//[]---------------------------------------------------[]
+//|  Put match                                          |
+//[]---------------------------------------------------[]
+{
+  int i = 28;
+
+  while (lengthBase[i] > length)
+    i--;
+  putSymbol(257 + i, out);
+  putBits(length - lengthBase[i], lengthExtra[i], out);
+  for (i = 29; distanceBase[i] > distance;)
+    i--;
+  putCode(i, 5, out);
+  putBits(distance - distanceBase[i], distanceExtra[i], out);
+}
+
+void
+Deflater::updateAdler(const uint8* data, int n)
+//[]---------------------------------------------------[]
+//|  Update Adler-32 checksum                           |
+//|  The sums are reduced every 5552 bytes, the most    |
+//|  that cannot overflow them                          |
+//[]---------------------------------------------------[]
+{
+  while (n > 0)
+  {
+    int m = n < 5552 ? n : 5552;
+
+    for (n -= m; m-- > 0;)
+      adlerB += adlerA += *data++;
+    adlerA %= 65521;
+    adlerB %= 65521;
+  }
+}
+
+void
+Deflater::compress(const uint8* data, int n, std::vector<uint8>& out)
+//[]---------------------------------------------------[]
+//|  Compress                                           |
+//|  Matches may reach back into earlier pieces, but    |
+//|  not forward into the next ones                     |
+//[]---------------------------------------------------[]
+{
+  if (!started)
+  {
+    // zlib header (deflate, 32 KB window), then a fixed Huffman block
+    out.push_back(0x78);
+    out.push_back(0x01);
+    putBits(0, 1, out);
+    putBits(1, 2, out);
+    started = true;
+  }
+  updateAdler(data, n);
+  // keep only the bytes that matches can still reach
+  if (window.size() > 2 * WINDOW_SIZE)
+  {
+    size_t d = window.size() - WINDOW_SIZE;
+
+    window.erase(window.begin(), window.begin() + d);
+    base += d;
+  }
+
+  int64 p = base + window.size();
+
+  window.insert(window.end(), data, data + n);
+
+  int64 end = base + window.size();
+
+  while (p < end)
+  {
+    const uint8* s = &window[p - base];
+    int avail = (int)dMin<int64>(end - p, MAX_MATCH);
+    int bestLength = 0;
+    int bestDistance = 0;
+
+    if (avail >= MIN_MATCH)
+    {
+      uint32 h = (((s[0] << 16) | (s[1] << 8) | s[2]) * 2654435761u) >>
+        (32 - HASH_BITS);
+      int chain = MAX_CHAIN;
+
+      for (int64 q = head[h];
+        q >= 0 && p - q < WINDOW_SIZE && chain-- > 0;
+        q = prev[q & (WINDOW_SIZE - 1)])
+      {
+        const uint8* t = &window[q - base];
+
+        if (t[bestLength] != s[bestLength])
+          continue;
+
+        int length = 0;
+
+        while (length < avail && t[length] == s[length])
+          length++;
+        if (length > bestLength)
+        {
+          bestLength = length;
+          bestDistance = (int)(p - q);
+          if (length == avail)
+            break;
+        }
+      }
+    }
+
+    int step = bestLength >= MIN_MATCH ? bestLength : 1;
+
+    if (step > 1)
+      putMatch(bestLength, bestDistance, out);
+    else
+      putSymbol(*s, out);
+    for (int64 e = p + step; p < e; p++)
+      if (end - p >= MIN_MATCH)
+      {
+        const uint8* t = &window[p - base];
+        uint32 h = (((t[0] << 16) | (t[1] << 8) | t[2]) * 2654435761u) >>
+          (32 - HASH_BITS);
+
+        prev[p & (WINDOW_SIZE - 1)] = head[h];
+        head[h] = p;
+      }
+  }
+}
+
+void
+Deflater::finish(std::vector<uint8>& out)
+//[]---------------------------------------------------[]
+//|  Finish                                             |
+//|  Ends the block and adds an empty final one         |
+//[]---------------------------------------------------[]
+{
+  if (!started)
+    compress(0, 0, out);
+  putSymbol(256, out);
+  putBits(1, 1, out);
+  putBits(1, 2, out);
+  putSymbol(256, out);
+  if (count > 0)
+    putBits(0, 8 - count, out);
+
+  uint8 adler[4];
+
+  putUint32(adler, (adlerB << 16) | adlerA);
+  out.insert(out.end(), adler, adler + 4);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// PNGEncoder: PNG encoder class
+// ==========
+class PNGEncoder: public ImageWriter::Encoder
+{
+public:
+  int rowSize(int w) const
+  {
+    return 3 * w;
+  }
+
+  bool isHDR() const
+  {
+    return false;
+  }
+
+  bool isSequential() const
+  {
+    return true;
+  }
+
+  bool begin(FILE*, int, int);
+  bool writeRow(FILE*, int, const uint8*);
+  bool end(FILE*);
+
+private:
+  int W;
+  Deflater deflater;
+  std::vector<uint8> idat;
+  std::vector<uint8> last;
+  std::vector<uint8> filtered[5];
+
+  static bool writeChunk(FILE*, const char*, const uint8*, uint32);
+
+}; // PNGEncoder
+
+inline int
+paeth(int a, int b, int c)
+{
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+
+  return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+bool
+PNGEncoder::writeChunk(FILE* file,
+  const char* type,
+  const uint8* data,
+  uint32 size)
+//[]---------------------------------------------------[]
+//|  Write chunk                                        |
+//[]---------------------------------------------------[]
+{
+  static struct CRCTable
+  {
+    uint32 entry[256];
+
+    CRCTable()
+    {
+      for (uint32 n = 0; n < 256; n++)
+      {
+        uint32 c = n;
+
+        for (int k = 0; k < 8; k++)
+          c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        entry[n] = c;
+      }
+    }
+
+  } table;
+  uint8 b[8];
+  uint32 crc = 0xffffffffu;
+
+  putUint32(b, size);
+  memcpy(b + 4, type, 4);
+  for (int i = 4; i < 8; i++)
+    crc = table.entry[(crc ^ b[i]) & 0xff] ^ (crc >> 8);
+  for (uint32 i = 0; i < size; i++)
+    crc = table.entry[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  if (fwrite(b, 1, 8, file) != 8 ||
+    (size > 0 && fwrite(data, 1, size, file) != size))
+    return false;
+  putUint32(b, crc ^ 0xffffffffu);
+  return fwrite(b, 1, 4, file) == 4;
+}
+
+bool
+PNGEncoder::begin(FILE* file, int w, int h)
+//[]---------------------------------------------------[]
+//|  Begin                                              |
+//[]---------------------------------------------------[]
+{
+  static const uint8 signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+  // 8 bit RGB, not interlaced
+  uint8 ihdr[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 2, 0, 0, 0};
+
+  W = w;
+  putUint32(ihdr, W);
+  putUint32(ihdr + 4, h);
+  last.assign(rowSize(W), 0);
+  for (int f = 0; f < 5; f++)
+    filtered[f].resize(rowSize(W) + 1);
+  return fwrite(signature, 1, 8, file) == 8 &&
+    writeChunk(file, "IHDR", ihdr, 13);
+}
+
+bool
+PNGEncoder::writeRow(FILE* file, int, const uint8* row)
+//[]---------------------------------------------------[]
+//|  Write row                                          |
+//|  The row is filtered as the filter that gives the   |
+//|  least sum of absolute differences, and compressed  |
+//[]---------------------------------------------------[]
+{
+  int n = rowSize(W);
+  int best = 0;
+  long bestSum = -1;
+
+  for (int f = 0; f < 5; f++)
+  {
+    uint8* d = filtered[f].data();
+    long sum = 0;
+
+    d[0] = (uint8)f;
+    for (int i = 0; i < n; i++)
+    {
+      int a = i >= 3 ? row[i - 3] : 0;
+      int b = last[i];
+      int c = i >= 3 ? last[i - 3] : 0;
+      int p = f == 0 ? 0 : f == 1 ? a : f == 2 ? b : f == 3 ? (a + b) >> 1 :
+        paeth(a, b, c);
+
+      d[i + 1] = (uint8)(row[i] - p);
+      sum += abs((int8)d[i + 1]);
+    }
+    if (bestSum < 0 || sum < bestSum)
+    {
+      best = f;
+      bestSum = sum;
+    }
+  }
+  deflater.compress(filtered[best].data(), n + 1, idat);
+  memcpy(last.data(), row, n);
+  if (idat.size() < PNG_IDAT_SIZE)
+    return true;
+
+  bool ok = writeChunk(file, "IDAT", idat.data(), (uint32)idat.size());
+
+  idat.clear();
+  return ok;
+}
+
+bool
+PNGEncoder::end(FILE* file)
+//[]---------------------------------------------------[]
+//|  End                                                |
+//[]---------------------------------------------------[]
+{
+  deflater.finish(idat);
+  return writeChunk(file, "IDAT", idat.data(), (uint32)idat.size()) &&
+    writeChunk(file, "IEND", 0, 0) &&
+    fflush(file) == 0;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// ImageWriter implementation
+// ===========
+ImageWriter*
+ImageWriter::open(const char* fileName, int w, int h)
+//[]---------------------------------------------------[]
+//|  Open                                               |
+//[]---------------------------------------------------[]
+{
+  Encoder* encoder;
+
+  if (hasExtension(fileName, "ppm"))
+    encoder = new PPMEncoder();
+  else if (hasExtension(fileName, "pfm"))
+    encoder = new PFMEncoder();
+  else if (hasExtension(fileName, "png"))
+    encoder = new PNGEncoder();
+  else
+    return 0;
+
+  FILE* file = fopen(fileName, "wb");
+
+  if (file == 0 || !encoder->begin(file, w, h))
+  {
+    if (file != 0)
+      fclose(file);
+    delete encoder;
+    return 0;
+  }
+  return new ImageWriter(file, encoder, w, h);
+}
+
+ImageWriter::ImageWriter(FILE* f, Encoder* e, int w, int h):
+  file(f),
+  encoder(e),
+  W(w),
+  H(h),
+  next(0),
+  closing(false),
+  failed(false)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  thread = std::thread(&ImageWriter::run, this);
+}
+
+ImageWriter::~ImageWriter()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  close();
+  delete encoder;
+}
+
+void
+ImageWriter::getSize(int& w, int& h) const
+//[]---------------------------------------------------[]
+//|  Get size                                           |
+//[]---------------------------------------------------[]
+{
+  w = W;
+  h = H;
+}
+
+bool
+ImageWriter::isHDR() const
+//[]---------------------------------------------------[]
+//|  Is HDR                                             |
+//[]---------------------------------------------------[]
+{
+  return encoder->isHDR();
+}
+
+bool
+ImageWriter::isTopDown() const
+//[]---------------------------------------------------[]
+//|  Is top down                                        |
+//[]---------------------------------------------------[]
+{
+  return encoder->isSequential();
+}
+
+void
+ImageWriter::write(int j, Pixel pixels[])
+//[]---------------------------------------------------[]
+//|  Write                                              |
+//[]---------------------------------------------------[]
+{
+  if (j < 0 || j >= H)
+    return;
+
+  Row row;
+
+  row.j = j;
+  row.data.resize(encoder->rowSize(W));
+  if (!encoder->isHDR())
+    memcpy(row.data.data(), pixels, row.data.size());
+  else
+  {
+    float* c = (float*)row.data.data();
+
+    for (int i = 0; i < W; i++, c += 3)
+    {
+      c[0] = pixels[i].r * Math::inverse<float>(255);
+      c[1] = pixels[i].g * Math::inverse<float>(255);
+      c[2] = pixels[i].b * Math::inverse<float>(255);
+    }
+  }
+  push(row);
+}
+
+void
+ImageWriter::writeHDR(int j, const Color colors[])
+//[]---------------------------------------------------[]
+//|  Write HDR                                          |
+//[]---------------------------------------------------[]
+{
+  if (j < 0 || j >= H)
+    return;
+
+  Row row;
+
+  row.j = j;
+  row.data.resize(encoder->rowSize(W));
+  if (encoder->isHDR())
+  {
+    float* c = (float*)row.data.data();
+
+    for (int i = 0; i < W; i++, c += 3)
+    {
+      c[0] = colors[i].r;
+      c[1] = colors[i].g;
+      c[2] = colors[i].b;
+    }
+  }
+  else
+  {
+    Pixel* p = (Pixel*)row.data.data();
+
+    for (int i = 0; i < W; i++)
+    {
+      Color t = colors[i];
+
+      for (int k = 0; k < 3; k++)
+        t[k] = t[k] < 0 ? 0 : t[k] > 1 ? 1 : t[k];
+      p[i] = t;
+    }
+  }
+  push(row);
+}
+
+void
+ImageWriter::push(Row& row)
+//[]---------------------------------------------------[]
+//|  Push                                               |
+//|  Waits while the queue is full, so that a renderer  |
+//|  faster than the disk does not pile up rows         |
+//[]---------------------------------------------------[]
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+
+    if (closing)
+      return;
+    dequeued.wait(guard, [this]()
+    {
+      return queue.size() < IMAGE_WRITER_QUEUE_SIZE;
+    });
+    queue.emplace_back();
+    queue.back().j = row.j;
+    queue.back().data.swap(row.data);
+  }
+  queued.notify_one();
+}
+
+void
+ImageWriter::run()
+//[]---------------------------------------------------[]
+//|  Run                                                |
+//|  Body of the writer thread                          |
+//[]---------------------------------------------------[]
+{
+  for (;;)
+  {
+    Row row;
+
+    {
+      std::unique_lock<std::mutex> guard(lock);
+
+      queued.wait(guard, [this]()
+      {
+        return !queue.empty() || closing;
+      });
+      if (queue.empty())
+        return;
+      row.j = queue.front().j;
+      row.data.swap(queue.front().data);
+      queue.pop_front();
+    }
+    dequeued.notify_one();
+    if (!encoder->isSequential())
+      writeRow(row.j, row.data.data());
+    else
+    {
+      pending[row.j].swap(row.data);
+      for (auto p = pending.find(H - 1 - next);
+        p != pending.end();
+        p = pending.find(H - 1 - next))
+      {
+        writeRow(p->first, p->second.data());
+        pending.erase(p);
+      }
+    }
+  }
+}
+
+void
+ImageWriter::writeRow(int j, const uint8* data)
+//[]---------------------------------------------------[]
+//|  Write row                                          |
+//[]---------------------------------------------------[]
+{
+  if (!failed && !encoder->writeRow(file, j, data))
+    failed = true;
+  next++;
+}
+
+bool
+ImageWriter::close()
+//[]---------------------------------------------------[]
+//|  Close                                              |
+//[]---------------------------------------------------[]
+{
+  if (file == 0)
+    return !failed;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+
+    closing = true;
+  }
+  queued.notify_one();
+  thread.join();
+  if (encoder->isSequential())
+  {
+    // rows never written are black
+    std::vector<uint8> black(encoder->rowSize(W), 0);
+
+    while (next < H)
+    {
+      auto p = pending.find(H - 1 - next);
+
+      writeRow(H - 1 - next, p != pending.end() ? p->second.data() :
+        black.data());
+    }
+    pending.clear();
+  }
+  if (!encoder->end(file))
+    failed = true;
+  if (fclose(file) != 0)
+    failed = true;
+  file = 0;
+  return !failed;
+}
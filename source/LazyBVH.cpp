@@ -0,0 +1,90 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: LazyBVH.cpp
+//  ========
+//  Source file for lazy BVH.
+
+#include "LazyBVH.h"
+#include "TriangleMesh.h"
+
+using namespace Graphics;
+
+
+//////////////////////////////////////////////////////////
+//
+// LazyBVH implementation
+// =======
+LazyBVH::LazyBVH(Model& m, const BVH::Options& o, Arena* a):
+  model(&m),
+  options(o),
+  arena(a),
+  built(false)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // The BVH is in the local space of the model, and so are the
+  // bounds: those of the mesh, if any, without the model transform
+  const TriangleMesh* mesh = m.triangleMesh();
+
+  bounds = mesh != 0 ? mesh->boundingBox() : m.boundingBox();
+}
+
+BVH*
+LazyBVH::build() const
+//[]---------------------------------------------------[]
+//|  Build                                              |
+//[]---------------------------------------------------[]
+{
+  std::call_once(once, [this]()
+  {
+    bvh = new BVH(model->refine(arena), options, arena);
+    built.store(true, std::memory_order_release);
+  });
+  return bvh;
+}
+
+bool
+LazyBVH::intersect(const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Intersect                                          |
+//[]---------------------------------------------------[]
+{
+  if (BVH* b = getBVH())
+    return b->intersect(ray, hit);
+
+  REAL d;
+
+  // Rays that only cross the bounds of the instance in the scene
+  // (which are looser) do not build the BVH
+  if (!bounds.intersect(ray, d))
+    return false;
+  return build()->intersect(ray, hit);
+}
+
+vec3
+LazyBVH::normal(const Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Normal                                             |
+//[]---------------------------------------------------[]
+{
+  // A hit comes from the BVH, so it is built
+  return getBVH()->normal(hit);
+}
+
+Bounds3
+LazyBVH::boundingBox() const
+//[]---------------------------------------------------[]
+//|  Bounding box                                       |
+//[]---------------------------------------------------[]
+{
+  return bounds;
+}
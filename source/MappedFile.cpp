@@ -0,0 +1,229 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: MappedFile.cpp
+//  ========
+//  Source file for memory-mapped file.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "MappedFile.h"
+
+using namespace System;
+
+
+//////////////////////////////////////////////////////////
+//
+// MappedFile implementation
+// ==========
+bool
+MappedFile::open(const char* fileName, bool copyOnWrite, Access access)
+//[]---------------------------------------------------[]
+//|  Open                                               |
+//|  Maps the whole file; empty files cannot be mapped  |
+//[]---------------------------------------------------[]
+{
+  close();
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName,
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    0,
+    OPEN_EXISTING,
+    access == Sequential ? FILE_FLAG_SEQUENTIAL_SCAN :
+    access == Random ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL,
+    0);
+
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+
+  if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+  {
+    HANDLE mapping = CreateFileMappingA(file,
+      0,
+      copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY,
+      0,
+      0,
+      0);
+
+    if (mapping != 0)
+    {
+      address = (char*)MapViewOfFile(mapping,
+        copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ,
+        0,
+        0,
+        0);
+      length = address != 0 ? (size_t)fileSize.QuadPart : 0;
+      // The view keeps the mapping alive
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+#else
+  int file = ::open(fileName, O_RDONLY);
+
+  if (file == -1)
+    return false;
+
+  struct stat s;
+
+  if (fstat(file, &s) == 0 && s.st_size > 0)
+  {
+    int protection = copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* p = mmap(0, s.st_size, protection, MAP_PRIVATE, file, 0);
+
+    if (p != MAP_FAILED)
+    {
+      if (access != Normal)
+        madvise(p,
+          s.st_size,
+          access == Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+      address = (char*)p;
+      length = s.st_size;
+    }
+  }
+  ::close(file);
+#endif
+  return address != 0;
+}
+
+bool
+MappedFile::create(const char* fileName, size_t size)
+//[]---------------------------------------------------[]
+//|  Create                                             |
+//[]---------------------------------------------------[]
+{
+  close();
+  if (size == 0)
+    return false;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName,
+    GENERIC_READ | GENERIC_WRITE,
+    0,
+    0,
+    CREATE_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL,
+    0);
+
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+
+  fileSize.QuadPart = (LONGLONG)size;
+
+  // The mapping extends the file to its size
+  HANDLE mapping = CreateFileMappingA(file,
+    0,
+    PAGE_READWRITE,
+    fileSize.HighPart,
+    fileSize.LowPart,
+    0);
+
+  if (mapping != 0)
+  {
+    address = (char*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    length = address != 0 ? size : 0;
+    CloseHandle(mapping);
+  }
+  CloseHandle(file);
+#else
+  int file = ::open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (file == -1)
+    return false;
+  if (ftruncate(file, (off_t)size) == 0)
+  {
+    void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+
+    if (p != MAP_FAILED)
+    {
+      address = (char*)p;
+      length = size;
+    }
+  }
+  ::close(file);
+#endif
+  return address != 0;
+}
+
+void
+MappedFile::discard(size_t offset, size_t n)
+//[]---------------------------------------------------[]
+//|  Discard                                            |
+//[]---------------------------------------------------[]
+{
+  if (offset >= length)
+    return;
+  if (n > length - offset)
+    n = length - offset;
+#ifdef _WIN32
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+
+  size_t begin = offset - offset % info.dwPageSize;
+
+  // Unlocking pages that are not locked removes them from the
+  // working set
+  VirtualUnlock(address + begin, offset + n - begin);
+#else
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  size_t begin = offset - offset % pageSize;
+
+  madvise(address + begin, offset + n - begin, MADV_DONTNEED);
+#endif
+}
+
+void
+MappedFile::flush(size_t offset, size_t n)
+//[]---------------------------------------------------[]
+//|  Flush                                              |
+//|  Does not wait for the pages to be written          |
+//[]---------------------------------------------------[]
+{
+  if (offset >= length)
+    return;
+  if (n > length - offset)
+    n = length - offset;
+#ifdef _WIN32
+  FlushViewOfFile(address + offset, n);
+#else
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  size_t begin = offset - offset % pageSize;
+
+  msync(address + begin, offset + n - begin, MS_ASYNC);
+#endif
+}
+
+void
+MappedFile::close()
+//[]---------------------------------------------------[]
+//|  Close                                              |
+//[]---------------------------------------------------[]
+{
+  if (address == 0)
+    return;
+#ifdef _WIN32
+  UnmapViewOfFile(address);
+#else
+  munmap((void*)address, length);
+#endif
+  address = 0;
+  length = 0;
+}
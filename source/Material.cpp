@@ -51,6 +51,7 @@ Material::setSurface(const Color& color, const Finish& finish)
 //
 // MaterialFactory implementation
 // ===============
+std::recursive_mutex MaterialFactory::lock;
 MaterialFactory::Materials MaterialFactory::materials;
 
 Material*
@@ -59,6 +60,7 @@ MaterialFactory::New(const Color& color)
 //|  Create material                                    |
 //[]---------------------------------------------------[]
 {
+  std::lock_guard<std::recursive_mutex> guard(lock);
   uint id = materials.size();
   char name[16];
 
@@ -76,6 +78,7 @@ MaterialFactory::New(const string& name, const Color& color)
 //|  Create material                                    |
 //[]---------------------------------------------------[]
 {
+  std::lock_guard<std::recursive_mutex> guard(lock);
   Material* material = get(name);
   
   if (material == 0)
@@ -89,6 +92,8 @@ MaterialFactory::get(const string& name)
 //|  Get material                                       |
 //[]---------------------------------------------------[]
 {
+  std::lock_guard<std::recursive_mutex> guard(lock);
+
   for (MaterialIterator mit(materials); mit; ++mit)
     if (name == mit.current()->getName())
       return mit.current();
@@ -0,0 +1,195 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: MeshCache.cpp
+//  ========
+//  Source file for mesh cache.
+
+#include <sys/stat.h>
+#include "MeshCache.h"
+#include "MeshReader.h"
+#include "MeshSweeper.h"
+#include "ThreadPool.h"
+
+using namespace Graphics;
+
+
+//////////////////////////////////////////////////////////
+//
+// MeshCache implementation
+// =========
+std::map<std::string, MeshCache::Entry> MeshCache::meshes;
+std::map<MeshCache::ShapeKey, ObjectPtr<TriangleMesh>> MeshCache::shapes;
+std::mutex MeshCache::lock;
+
+MeshCache::MeshFuture
+MeshCache::find(const char* fileName)
+//[]---------------------------------------------------[]
+//|  Find                                               |
+//|  Returns the pending or finished reading of a file, |
+//|  starting it if the file is not cached or was       |
+//|  modified since it was read                         |
+//[]---------------------------------------------------[]
+{
+  struct stat s;
+
+  if (stat(fileName, &s) != 0)
+    return MeshFuture();
+
+  std::lock_guard<std::mutex> guard(lock);
+  Entry& e = meshes[fileName];
+
+  if (!e.mesh.valid() || e.modified != s.st_mtime)
+  {
+    std::string name(fileName);
+
+    e.mesh = ThreadPool::getDefault().run([name]()
+    {
+      return ObjectPtr<TriangleMesh>(MeshReader().execute(name.c_str()));
+    }).share();
+    e.modified = s.st_mtime;
+  }
+  return e.mesh;
+}
+
+TriangleMesh*
+MeshCache::get(const char* fileName)
+//[]---------------------------------------------------[]
+//|  Get                                                |
+//|  Returns the mesh of a file, waiting for it to be   |
+//|  read if needed, or 0 if it cannot be read          |
+//[]---------------------------------------------------[]
+{
+  MeshFuture mesh = find(fileName);
+
+  if (!mesh.valid())
+    return 0;
+  ThreadPool::getDefault().wait(mesh);
+  return mesh.get();
+}
+
+TriangleMesh*
+MeshCache::getShape(const ShapeKey& key, TriangleMesh* (*make)(int))
+//[]---------------------------------------------------[]
+//|  Get shape                                          |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+  ObjectPtr<TriangleMesh>& mesh = shapes[key];
+
+  if (mesh == 0)
+    mesh = make(key.second);
+  return mesh;
+}
+
+TriangleMesh*
+MeshCache::getSphere(int meridians)
+//[]---------------------------------------------------[]
+//|  Get sphere                                         |
+//[]---------------------------------------------------[]
+{
+  // Same clamping as MeshSweeper::makeSphere()
+  if (meridians < 6)
+    meridians = 6;
+  return getShape(ShapeKey(Sphere, meridians), [](int n)
+  {
+    return MeshSweeper::makeSphere(vec3::null(), 1, n);
+  });
+}
+
+TriangleMesh*
+MeshCache::getBox()
+//[]---------------------------------------------------[]
+//|  Get box                                            |
+//[]---------------------------------------------------[]
+{
+  return getShape(ShapeKey(Box, 0), [](int)
+  {
+    return MeshSweeper::makeCube();
+  });
+}
+
+TriangleMesh*
+MeshCache::getCylinder(int segments)
+//[]---------------------------------------------------[]
+//|  Get cylinder                                       |
+//[]---------------------------------------------------[]
+{
+  if (segments < 3)
+    segments = 3;
+  return getShape(ShapeKey(Cylinder, segments), [](int n)
+  {
+    return MeshSweeper::makeCylinder(vec3::null(), 1, vec3::up(), n);
+  });
+}
+
+TriangleMesh*
+MeshCache::getCone(int segments)
+//[]---------------------------------------------------[]
+//|  Get cone                                           |
+//[]---------------------------------------------------[]
+{
+  if (segments < 3)
+    segments = 3;
+  return getShape(ShapeKey(Cone, segments), [](int n)
+  {
+    return MeshSweeper::makeCone(vec3::null(), 1, vec3::up(), n);
+  });
+}
+
+void
+MeshCache::clear()
+//[]---------------------------------------------------[]
+//|  Clear                                              |
+//|  Pending readings finish, but are not cached        |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  meshes.clear();
+  shapes.clear();
+}
+
+int
+MeshCache::size()
+//[]---------------------------------------------------[]
+//|  Size                                               |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return (int)(meshes.size() + shapes.size());
+}
+
+void
+MeshCache::purge()
+//[]---------------------------------------------------[]
+//|  Purge                                              |
+//|  Removes the meshes used only by the cache          |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  for (auto i = meshes.begin(); i != meshes.end();)
+  {
+    const MeshFuture& mesh = i->second.mesh;
+
+    // Readings in progress stay
+    if (mesh.wait_for(std::chrono::seconds(0)) == std::future_status::ready &&
+      (mesh.get() == 0 || mesh.get()->getNumberOfUses() == 1))
+      i = meshes.erase(i);
+    else
+      ++i;
+  }
+  for (auto i = shapes.begin(); i != shapes.end();)
+    if (i->second->getNumberOfUses() == 1)
+      i = shapes.erase(i);
+    else
+      ++i;
+}
@@ -0,0 +1,215 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: MeshFile.cpp
+//  ========
+//  Source file for binary mesh file.
+
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include "MappedFile.h"
+#include "MeshFile.h"
+
+using namespace Graphics;
+
+#define MESH_FILE_BYTE_ORDER 0x01020304u
+
+inline uint64_t
+alignOffset(uint64_t offset)
+{
+  return (offset + MESH_FILE_ALIGNMENT - 1) & ~uint64_t(MESH_FILE_ALIGNMENT - 1);
+}
+
+inline uint64_t
+placeArray(uint64_t& size, size_t length)
+{
+  // Empty arrays are absent and take no space
+  if (length == 0)
+    return 0;
+
+  uint64_t offset = alignOffset(size);
+
+  size = offset + length;
+  return offset;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// MappedTriangleMesh: triangle mesh in a mapped file
+// ==================
+class MappedTriangleMesh: public TriangleMesh
+{
+public:
+  // Constructor
+  MappedTriangleMesh(const Arrays& a, MappedFile* f):
+    TriangleMesh(a),
+    file(f)
+  {
+    // do nothing
+  }
+
+  // Destructor
+  ~MappedTriangleMesh()
+  {
+    // Arrays in the mapping are not owned by the mesh, but arrays
+    // replaced later (e.g., by computeNormals()) are
+    disown(data.vertices);
+    disown(data.normals);
+    disown(data.vertexColors);
+    disown(data.triangles);
+  }
+
+private:
+  std::unique_ptr<MappedFile> file;
+
+  template <typename T>
+  void disown(T*& p)
+  {
+    const char* c = (const char*)p;
+
+    if (c >= file->data() && c < file->data() + file->size())
+      p = 0;
+  }
+
+}; // MappedTriangleMesh
+
+template <typename T>
+static bool
+writeArray(FILE* file, uint64_t offset, const T* data, int n)
+{
+  if (n == 0)
+    return true;
+#ifdef _WIN32
+  if (_fseeki64(file, offset, SEEK_SET) != 0)
+#else
+  if (fseeko(file, offset, SEEK_SET) != 0)
+#endif
+    return false;
+  return fwrite(data, sizeof(T), n, file) == (size_t)n;
+}
+
+template <typename T>
+static bool
+getArray(const MappedFile& file, uint64_t offset, int n, T*& data)
+{
+  if (offset == 0)
+  {
+    data = 0;
+    return n == 0;
+  }
+  if (n < 0 || offset % MESH_FILE_ALIGNMENT != 0 ||
+    offset > file.size() || (file.size() - offset) / sizeof(T) < (size_t)n)
+    return false;
+  data = (T*)(file.data() + offset);
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// MeshFile implementation
+// ========
+bool
+MeshFile::write(const char* fileName, const TriangleMesh::Arrays& data)
+//[]---------------------------------------------------[]
+//|  Write                                              |
+//[]---------------------------------------------------[]
+{
+  Header h;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MESH_FILE_MAGIC, 4);
+  h.version = MESH_FILE_VERSION;
+  h.byteOrder = MESH_FILE_BYTE_ORDER;
+  h.realSize = sizeof(REAL);
+  h.numberOfVertices = data.numberOfVertices;
+  h.numberOfNormals = data.normals != 0 ? data.numberOfNormals : 0;
+  h.numberOfVertexColors = data.vertexColors != 0 ? data.numberOfVertexColors : 0;
+  h.numberOfTriangles = data.numberOfTriangles;
+
+  h.size = sizeof(Header);
+  h.vertices = placeArray(h.size, h.numberOfVertices * sizeof(vec3));
+  h.normals = placeArray(h.size, h.numberOfNormals * sizeof(vec3));
+  h.vertexColors = placeArray(h.size, h.numberOfVertexColors * sizeof(Color));
+  h.triangles = placeArray(h.size,
+    h.numberOfTriangles * sizeof(TriangleMesh::Triangle));
+
+  FILE* file = fopen(fileName, "wb");
+
+  if (file == 0)
+    return false;
+
+  bool ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+    writeArray(file, h.vertices, data.vertices, h.numberOfVertices) &&
+    writeArray(file, h.normals, data.normals, h.numberOfNormals) &&
+    writeArray(file, h.vertexColors, data.vertexColors, h.numberOfVertexColors) &&
+    writeArray(file, h.triangles, data.triangles, h.numberOfTriangles);
+
+  return fclose(file) == 0 && ok;
+}
+
+TriangleMesh*
+MeshFile::read(const char* fileName)
+//[]---------------------------------------------------[]
+//|  Read                                               |
+//|  Returns 0 if the file cannot be mapped or was not  |
+//|  written by a compatible build                      |
+//[]---------------------------------------------------[]
+{
+  // The view is copy-on-write, so the mesh can still be changed
+  // (e.g., transformed) without touching the file. Its arrays are
+  // read where rays hit them
+  std::unique_ptr<MappedFile> file(new MappedFile(fileName,
+    true,
+    MappedFile::Random));
+
+  if (!file->isOpen() || file->size() < sizeof(Header))
+    return 0;
+
+  const Header& h = *(const Header*)file->data();
+  TriangleMesh::Arrays data;
+
+  if (memcmp(h.magic, MESH_FILE_MAGIC, 4) != 0 ||
+    h.version != MESH_FILE_VERSION ||
+    h.byteOrder != MESH_FILE_BYTE_ORDER ||
+    h.realSize != sizeof(REAL) ||
+    h.size != file->size() ||
+    !getArray(*file, h.vertices, h.numberOfVertices, data.vertices) ||
+    !getArray(*file, h.normals, h.numberOfNormals, data.normals) ||
+    !getArray(*file, h.vertexColors, h.numberOfVertexColors, data.vertexColors) ||
+    !getArray(*file, h.triangles, h.numberOfTriangles, data.triangles))
+  {
+    printf("Invalid mesh file %s\n", fileName);
+    return 0;
+  }
+  data.numberOfVertices = h.numberOfVertices;
+  data.numberOfNormals = h.numberOfNormals;
+  data.numberOfVertexColors = h.numberOfVertexColors;
+  data.numberOfTriangles = h.numberOfTriangles;
+
+  TriangleMesh* mesh = new MappedTriangleMesh(data, file.release());
+
+  if (!mesh->hasNormals())
+    mesh->computeNormals();
+  return mesh;
+}
+
+bool
+MeshFile::isMeshFile(const char* fileName)
+//[]---------------------------------------------------[]
+//|  Is mesh file                                       |
+//[]---------------------------------------------------[]
+{
+  const char* ext = strrchr(fileName, '.');
+
+  return ext != 0 && strcmp(ext, ".bmesh") == 0;
+}
@@ -12,8 +12,17 @@
 //  ========
 //  Source file for mesh reader.
 
+#include <algorithm>
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+#include "MeshFile.h"
 #include "MeshReader.h"
+#include "ThreadPool.h"
 
 using namespace Graphics;
 
@@ -87,252 +96,443 @@ readMaterialFile(const char* fileName)
   puts("done");
 }
 
+//
+// Wavefront OBJ parsing
+//
+// The file is mapped and split into line-aligned chunks that are
+// parsed in parallel, one per hardware thread. Each chunk counts its
+// own vertices and normals, so positive (absolute) indices are kept
+// as read, while negative (relative) ones are resolved against the
+// chunk and fixed when the chunks are merged at their offsets.
+//
+#define OBJ_MIN_CHUNK_SIZE (256 << 10)
+
+struct ObjCorner
+{
+  int v;
+  int n; // -1 if none
+  bool relativeV;
+  bool relativeN;
+
+}; // ObjCorner
+
+struct ObjChunk
+{
+  const char* begin;
+  const char* end;
+  std::vector<vec3> vertices;
+  std::vector<vec3> normals;
+  std::vector<TriangleMesh::Triangle> triangles;
+  std::vector<TriangleMesh::Triangle> triangleNormals;
+  // Corners (3 * triangle + i) whose index is relative to the chunk
+  std::vector<int> relativeVertices;
+  std::vector<int> relativeNormals;
+  std::vector<std::string> materialFiles;
+  bool missingNormals;
+
+  ObjChunk():
+    missingNormals(false)
+  {
+    // do nothing
+  }
+
+  void parse();
+  const char* parseFace(const char*);
+  bool parseCorner(const char*&, ObjCorner&) const;
+  void addTriangle(const ObjCorner&, const ObjCorner&, const ObjCorner&);
+
+}; // ObjChunk
+
+inline bool
+isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool
+isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+inline const char*
+skipBlanks(const char* p, const char* end)
+{
+  while (p < end && isBlank(*p))
+    p++;
+  return p;
+}
+
+inline const char*
+skipLine(const char* p, const char* end)
+{
+  while (p < end && *p != '\n')
+    p++;
+  return p < end ? p + 1 : end;
+}
+
+inline bool
+parseInt(const char*& p, const char* end, int& value)
+{
+  bool negative = false;
+
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+  if (p == end || !isDigit(*p))
+    return false;
+
+  int i = 0;
+
+  while (p < end && isDigit(*p))
+    i = i * 10 + (*p++ - '0');
+  value = negative ? -i : i;
+  return true;
+}
+
+static double
+power10(int e)
+{
+  // Powers of ten up to 1e22 are exact in double precision
+  static const double table[] =
+  {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  return e <= 22 ? table[e] : pow(10.0, e);
+}
+
+static bool
+parseReal(const char*& p, const char* end, REAL& value)
+{
+  bool negative = false;
+
+  p = skipBlanks(p, end);
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+
+  // Keep the first 19 significant digits in an integer and scale it
+  // once by the decimal exponent
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+
+  for (; p < end && isDigit(*p); p++, any = true)
+    if (digits < 19)
+    {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    }
+    else
+      exponent++;
+  if (p < end && *p == '.')
+    for (p++; p < end && isDigit(*p); p++, any = true)
+      if (digits < 19)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+  if (!any)
+    return false;
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char* q = p + 1;
+    int e;
+
+    if (parseInt(q, end, e))
+    {
+      exponent += e;
+      p = q;
+    }
+  }
+
+  double d = (double)mantissa;
+
+  d = exponent < 0 ? d / power10(-exponent) : d * power10(exponent);
+  value = REAL(negative ? -d : d);
+  return true;
+}
+
+static bool
+parseVector(const char*& p, const char* end, vec3& v)
+{
+  REAL x;
+  REAL y;
+  REAL z;
+
+  if (!parseReal(p, end, x) || !parseReal(p, end, y) || !parseReal(p, end, z))
+    return false;
+  v.set(x, y, z);
+  return true;
+}
+
 void
-readMeshSize(FILE* file, TriangleMesh::Arrays& data)
+ObjChunk::parse()
 {
-  int nv = 0;
-  int nn = 0;
-  int nt = 0;
+  for (const char* p = begin; p < end; p = skipLine(p, end))
+  {
+    p = skipBlanks(p, end);
+    if (p == end)
+      break;
 
-  for (char strm[128]; fscanf(file, "%s", strm) != EOF;)
-    switch (strm[0])
+    vec3 v;
+
+    switch (*p)
     {
       case 'v':
-        switch (strm[1])
+        if (p + 1 < end && isBlank(p[1]))
         {
-          case '\0':
-            nv++;
-            break;
-        
-          case 'n':
-            nn++;
-            break;
+          if (parseVector(p += 1, end, v))
+            vertices.push_back(v);
+        }
+        else if (p + 2 < end && p[1] == 'n' && isBlank(p[2]))
+        {
+          if (parseVector(p += 2, end, v))
+            normals.push_back(v);
         }
-        fgets(strm, sizeof(strm), file);
         break;
 
       case 'f':
-      {
-        int v;
-        int n;
-        int t;
+        if (p + 1 < end && isBlank(p[1]))
+          p = parseFace(p + 1);
+        break;
 
-        fscanf(file, "%s", strm);
-        /* can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
-        if (strstr(strm, "//"))
-        {
-          /* v//n */
-          sscanf(strm, "%d//%d", &v, &n);
-          fscanf(file, "%d//%d", &v, &n);
-          fscanf(file, "%d//%d", &v, &n);
-          nt++;
-          while (fscanf(file, "%d//%d", &v, &n) > 0)
-            nt++;
-        }
-        else if (sscanf(strm, "%d/%d/%d", &v, &t, &n) == 3)
-        {
-          /* v/t/n */
-          fscanf(file, "%d/%d/%d", &v, &t, &n);
-          fscanf(file, "%d/%d/%d", &v, &t, &n);
-          nt++;
-          while (fscanf(file, "%d/%d/%d", &v, &t, &n) > 0)
-            nt++;
-        }
-        else if (sscanf(strm, "%d/%d", &v, &t) == 2)
-        {
-          /* v/t */
-          fscanf(file, "%d/%d", &v, &t);
-          fscanf(file, "%d/%d", &v, &t);
-          nt++;
-          while (fscanf(file, "%d/%d", &v, &t) > 0)
-            nt++;
-        }
-        else
+      case 'm':
+        if (end - p > 6 && strncmp(p, "mtllib", 6) == 0 && isBlank(p[6]))
         {
-          /* v */
-          fscanf(file, "%d", &v);
-          fscanf(file, "%d", &v);
-          nt++;
-          while (fscanf(file, "%d", &v) > 0)
-            nt++;
+          const char* name = skipBlanks(p + 6, end);
+
+          for (p = name; p < end && *p != '\n' && !isBlank(*p);)
+            p++;
+          if (p > name)
+            materialFiles.push_back(std::string(name, p));
         }
         break;
-      }
+    }
+  }
+}
 
-      case 'm':
-        fscanf(file, "%s", strm);
-        readMaterialFile(strm);
-        break;
+bool
+ObjChunk::parseCorner(const char*& p, ObjCorner& c) const
+{
+  // Can be one of v, v/t, v//n or v/t/n
+  int t;
+
+  p = skipBlanks(p, end);
+  if (!parseInt(p, end, c.v) || c.v == 0)
+    return false;
+  c.n = 0;
+  if (p < end && *p == '/')
+  {
+    if (++p < end && *p != '/')
+      parseInt(p, end, t);
+    if (p < end && *p == '/')
+      parseInt(++p, end, c.n);
+  }
+  if ((c.relativeV = c.v < 0))
+    c.v += (int)vertices.size();
+  else
+    c.v--;
+  if ((c.relativeN = c.n < 0))
+    c.n += (int)normals.size();
+  else
+    c.n--;
+  return true;
+}
 
-      default:
-        fgets(strm, sizeof(strm), file);
-    }
-  data.numberOfVertices = nv;
-  data.numberOfNormals = 0/* nn */;
-  data.numberOfTriangles = nt;
+const char*
+ObjChunk::parseFace(const char* p)
+{
+  // Polygons are split into fans around their first corner
+  ObjCorner first;
+  ObjCorner last;
+  ObjCorner c;
+
+  for (int i = 0; parseCorner(p, c); i++)
+  {
+    if (i == 0)
+      first = c;
+    else if (i >= 2)
+      addTriangle(first, last, c);
+    last = c;
+  }
+  return p;
 }
 
 void
-readMeshData(FILE* file, TriangleMesh::Arrays& data)
+ObjChunk::addTriangle(const ObjCorner& c0,
+  const ObjCorner& c1,
+  const ObjCorner& c2)
 {
-  vec3* vertex = data.vertices;
-  // vec3* normal = data.normals;
-  TriangleMesh::Triangle* triangle = data.triangles;
-  Material* material = MaterialFactory::getDefaultMaterial();
-
-  for (char strm[128]; fscanf(file, "%s", strm) != EOF;)
-    switch (strm[0])
-    {
-      case 'v':
-      {
-        REAL x;
-        REAL y;
-        REAL z;
+  const ObjCorner* c[] = {&c0, &c1, &c2};
+  int corner = 3 * (int)triangles.size();
+  TriangleMesh::Triangle v;
+  TriangleMesh::Triangle n;
 
-        switch (strm[1])
-        {
-          case '\0':
-            fscanf(file, "%f %f %f", &x, &y, &z);
-            vertex->set(x, y, z);
-            vertex++;
-            break;
+  for (int i = 0; i < 3; i++, corner++)
+  {
+    v.v[i] = c[i]->v;
+    n.v[i] = c[i]->n;
+    if (c[i]->relativeV)
+      relativeVertices.push_back(corner);
+    if (c[i]->relativeN)
+      relativeNormals.push_back(corner);
+    else if (c[i]->n < 0)
+      missingNormals = true;
+  }
+  triangles.push_back(v);
+  triangleNormals.push_back(n);
+}
 
-          case 'n':
-            fscanf(file, "%f %f %f", &x, &y, &z);
-            // normal->set(x, y, z);
-            // normal++;
-            break;
+static bool
+setNormals(TriangleMesh::Arrays& data,
+  const std::vector<vec3>& normals,
+  const std::vector<TriangleMesh::Triangle>& triangleNormals)
+{
+  // The mesh has one normal per vertex, so a vertex used with more
+  // than one normal is split, once for each extra normal
+  int nv = data.numberOfVertices;
+  int nn = (int)normals.size();
+  std::vector<int> normalOf(nv, -1);
+  std::vector<int> splitVertices;
+  std::vector<int> splitNormals;
+  std::unordered_map<long long, int> splits;
+
+  for (int t = 0; t < data.numberOfTriangles; t++)
+    for (int i = 0; i < 3; i++)
+    {
+      int v = data.triangles[t].v[i];
+      int n = triangleNormals[t].v[i];
 
-          default:
-            fgets(strm, sizeof(strm), file);
-        }
-        break;
-      }
+      if (v < 0 || v >= nv || n < 0 || n >= nn)
+        return false;
+    }
+  for (int t = 0; t < data.numberOfTriangles; t++)
+    for (int i = 0; i < 3; i++)
+    {
+      int& v = data.triangles[t].v[i];
+      int n = triangleNormals[t].v[i];
 
-      case 'f':
+      if (normalOf[v] == -1)
+        normalOf[v] = n;
+      else if (normalOf[v] != n)
       {
-        int v;
-        int n;
-        int t;
-
-        triangle->v[3] = material->getIndex();
-        fscanf(file, "%s", strm);
-        /* Can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
-        if (strstr(strm, "//"))
-        {
-          /* v//n */
-          sscanf(strm, "%d//%d", &v, &n);
-          triangle->v[0] = v - 1;
-          // triangle->n[0] = n - 1;
-          fscanf(file, "%d//%d", &v, &n);
-          triangle->v[1] = v - 1;
-          // triangle->n[1] = n - 1;
-          fscanf(file, "%d//%d", &v, &n);
-          triangle->v[2] = v - 1;
-          // triangle->n[2] = triangle->n[3] = n - 1;
-          triangle++;
-          while (fscanf(file, "%d//%d", &v, &n) > 0)
-          {
-            triangle->v[0] = triangle[-1].v[0];
-            // triangle->n[0] = triangle[-1].n[0];
-            triangle->v[1] = triangle[-1].v[2];
-            // triangle->n[1] = triangle[-1].n[2];
-            triangle->v[2] = v - 1;
-            // triangle->n[2] = triangle->n[3] = n - 1;
-            triangle++;
-          }
-        }
-        else if (sscanf(strm, "%d/%d/%d", &v, &t, &n) == 3)
-        {
-          /* v/t/n */
-          triangle->v[0] = v - 1;
-          // triangle->t[0] = t - 1;
-          // triangle->n[0] = n - 1;
-          fscanf(file, "%d/%d/%d", &v, &t, &n);
-          triangle->v[1] = v - 1;
-          // triangle->t[1] = t - 1;
-          // triangle->n[1] = n - 1;
-          fscanf(file, "%d/%d/%d", &v, &t, &n);
-          triangle->v[2] = v - 1;
-          // triangle->t[2] = t - 1;
-          // triangle->n[2] = triangle->n[3] = n - 1;
-          triangle++;
-          while (fscanf(file, "%d/%d/%d", &v, &t, &n) > 0)
-          {
-            triangle->v[0] = triangle[-1].v[0];
-            // triangle->t[0] = triangle[-1].t[0];
-            // triangle->n[0] = triangle[-1].n[0];
-            triangle->v[1] = triangle[-1].v[2];
-            // triangle->t[1] = triangle[-1].t[2];
-            // triangle->n[1] = triangle[-1].n[2];
-            triangle->v[2] = v - 1;
-            // triangle->tindices[2] = t - 1;
-            // triangle->n[2] = triangle->n[3] = n - 1;
-            triangle++;
-          }
-        }
-        else if (sscanf(strm, "%d/%d", &v, &t) == 2)
-        {
-          /* v/t */
-          triangle->v[0] = v - 1;
-          // triangle->t[0] = t - 1;
-          fscanf(file, "%d/%d", &v, &t);
-          triangle->v[1] = v - 1;
-          // triangle->t[1] = t - 1;
-          fscanf(file, "%d/%d", &v, &t);
-          triangle->v[2] = v - 1;
-          // triangle->t[2] = t - 1;
-          // triangle->setNormal(-1);
-          triangle++;
-          while (fscanf(file, "%d/%d", &v, &t) > 0)
-          {
-            triangle->v[0] = triangle[-1].v[0];
-            // triangle->t[0] = triangle[-1].t[0];
-            triangle->v[1] = triangle[-1].v[2];
-            // triangle->t[1] = triangle[-1].t[2];
-            triangle->v[2] = v - 1;
-            // triangle->t[2] = t - 1;
-            // triangle->setNormal(-1);
-            triangle++;
-          }
-        }
+        long long key = (long long)v * nn + n;
+        auto s = splits.find(key);
+
+        if (s != splits.end())
+          v = s->second;
         else
         {
-          /* v */
-          sscanf(strm, "%d", &v);
-          triangle->v[0] = v - 1;
-          fscanf(file, "%d", &v);
-          triangle->v[1] = v - 1;
-          fscanf(file, "%d", &v);
-          triangle->v[2] = v - 1;
-          // triangle->setNormal(-1);
-          triangle++;
-          while (fscanf(file, "%d", &v) > 0)
-          {
-            triangle->v[0] = triangle[-1].v[0];
-            triangle->v[1] = triangle[-1].v[2];
-            triangle->v[2] = v - 1;
-            // triangle->setNormal(-1);
-            triangle++;
-          }
+          splits[key] = nv + (int)splitVertices.size();
+          splitVertices.push_back(v);
+          splitNormals.push_back(n);
+          v = splits[key];
         }
-        break;
       }
+    }
 
-      case 'u':
-      {
-        fscanf(file, "%s", strm);
+  int ns = (int)splitVertices.size();
 
-        Material* m = MaterialFactory::get(strm);
+  if (ns > 0)
+  {
+    vec3* vertices = new vec3[nv + ns];
 
-        if (m != 0)
-          material = m;
-        break;
-      }
+    memcpy(vertices, data.vertices, nv * sizeof(vec3));
+    for (int i = 0; i < ns; i++)
+      vertices[nv + i] = data.vertices[splitVertices[i]];
+    delete []data.vertices;
+    data.vertices = vertices;
+  }
+  data.normals = new vec3[data.numberOfNormals = nv + ns];
+  for (int i = 0; i < nv; i++)
+    data.normals[i] = normalOf[i] < 0 ? vec3::null() : normals[normalOf[i]];
+  for (int i = 0; i < ns; i++)
+    data.normals[nv + i] = normals[splitNormals[i]];
+  data.numberOfVertices = nv + ns;
+  return true;
+}
 
-      default:
-        fgets(strm, sizeof(strm), file);
-    }
+static bool
+readMesh(const MappedFile& file,
+  TriangleMesh::Arrays& data,
+  std::vector<std::string>& materialFiles)
+{
+  const char* text = file.data();
+  size_t size = file.size();
+  ThreadPool& pool = ThreadPool::getDefault();
+  // The pool workers and the calling thread
+  int numberOfChunks = (int)dMin<size_t>(pool.size() + 1,
+    size / OBJ_MIN_CHUNK_SIZE);
+
+  if (numberOfChunks < 1)
+    numberOfChunks = 1;
+
+  std::vector<ObjChunk> chunks(numberOfChunks);
+
+  // Split the file at line ends
+  for (int i = 0; i < numberOfChunks; i++)
+  {
+    ObjChunk& c = chunks[i];
+
+    c.begin = i == 0 ? text : chunks[i - 1].end;
+    c.end = i == numberOfChunks - 1 ?
+      text + size :
+      skipLine(dMax(c.begin, text + size * (i + 1) / numberOfChunks), text + size);
+  }
+  pool.forEach(numberOfChunks, [&](int i) { chunks[i].parse(); });
+
+  // Offsets of the chunks in the mesh arrays
+  std::vector<int> vertexOffset(numberOfChunks + 1, 0);
+  std::vector<int> normalOffset(numberOfChunks + 1, 0);
+  std::vector<int> triangleOffset(numberOfChunks + 1, 0);
+  bool missingNormals = false;
+
+  for (int i = 0; i < numberOfChunks; i++)
+  {
+    const ObjChunk& c = chunks[i];
+
+    vertexOffset[i + 1] = vertexOffset[i] + (int)c.vertices.size();
+    normalOffset[i + 1] = normalOffset[i] + (int)c.normals.size();
+    triangleOffset[i + 1] = triangleOffset[i] + (int)c.triangles.size();
+    missingNormals |= c.missingNormals;
+    materialFiles.insert(materialFiles.end(),
+      c.materialFiles.begin(),
+      c.materialFiles.end());
+  }
+  data.numberOfVertices = vertexOffset[numberOfChunks];
+  data.numberOfTriangles = triangleOffset[numberOfChunks];
+  data.vertices = new vec3[data.numberOfVertices];
+  data.triangles = new TriangleMesh::Triangle[data.numberOfTriangles];
+
+  bool keepNormals = normalOffset[numberOfChunks] > 0 && !missingNormals;
+  std::vector<vec3> normals(keepNormals ? normalOffset[numberOfChunks] : 0);
+  std::vector<TriangleMesh::Triangle> triangleNormals(keepNormals ?
+    data.numberOfTriangles : 0);
+
+  pool.forEach(numberOfChunks, [&](int i)
+  {
+    const ObjChunk& c = chunks[i];
+    TriangleMesh::Triangle* t = data.triangles + triangleOffset[i];
+
+    std::copy(c.vertices.begin(), c.vertices.end(),
+      data.vertices + vertexOffset[i]);
+    std::copy(c.triangles.begin(), c.triangles.end(), t);
+    for (int corner : c.relativeVertices)
+      t[corner / 3].v[corner % 3] += vertexOffset[i];
+    if (!keepNormals)
+      return;
+    std::copy(c.normals.begin(), c.normals.end(),
+      normals.begin() + normalOffset[i]);
+    t = &triangleNormals[0] + triangleOffset[i];
+    std::copy(c.triangleNormals.begin(), c.triangleNormals.end(), t);
+    for (int corner : c.relativeNormals)
+      t[corner / 3].v[corner % 3] += normalOffset[i];
+  });
+  // Faces with bad indices are left to computeNormals()
+  return keepNormals && setNormals(data, normals, triangleNormals);
 }
 
 
@@ -344,33 +544,36 @@ TriangleMesh*
 MeshReader::execute(const char* fileName)
 //[]----------------------------------------------------[]
 //|  Execute (read Wavefront OBJ file)                   |
+//|  Normals given by vn lines are kept if every face    |
+//|  corner refers to one; otherwise they are computed   |
+//|  Then the mesh is optimized for locality             |
+//|  Binary mesh files (.bmesh) are mapped instead       |
 //[]----------------------------------------------------[]
 {
-  FILE* file = fopen(fileName, "r");
+  if (MeshFile::isMeshFile(fileName))
+    return MeshFile::read(fileName);
 
-  if (file == 0)
+  MappedFile file(fileName, false, MappedFile::Sequential);
+
+  if (!file.isOpen())
     return 0;
 
   TriangleMesh::Arrays data;
+  std::vector<std::string> materialFiles;
 
-  readMeshSize(file, data);
-  data.vertices = new vec3[data.numberOfVertices];
-  if (data.numberOfNormals != 0)
-    data.normals = new vec3[data.numberOfNormals];
-  data.triangles = new TriangleMesh::Triangle[data.numberOfTriangles];
-  rewind(file);
   printf("Reading Wavefront OBJ file %s... ", fileName);
-  readMeshData(file, data);
-  fclose(file);
+
+  bool hasNormals = readMesh(file, data, materialFiles);
+
   puts("done");
-  /*
-  file = fopen("a.msh", "w");
-  data.print(file);
-  fclose(file);
-  */
+  for (const std::string& m : materialFiles)
+    readMaterialFile(m.c_str());
 
   TriangleMesh* mesh = new TriangleMesh(data);
 
-  mesh->computeNormals();
+  if (!hasNormals)
+    mesh->computeNormals();
+  // After the normals, so that vertices split at creases stay split
+  mesh->optimize();
   return mesh;
 }
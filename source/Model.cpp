@@ -46,7 +46,7 @@ Model::canIntersect() const
 }
 
 Array<ModelPtr>
-Model::refine() const
+Model::refine(Arena*) const
 //[]---------------------------------------------------[]
 //|  Refine                                             |
 //[]---------------------------------------------------[]
@@ -67,6 +67,29 @@ Model::triangleMesh() const
   return 0;
 }
 
+Bounds3
+Model::clippedBoundingBox(const Bounds3& box) const
+//[]---------------------------------------------------[]
+//|  Clipped bounding box                               |
+//|  Returns the bounds of the part of the model inside |
+//|  box. The default is the intersection between box   |
+//|  and the bounding box of the model                  |
+//[]---------------------------------------------------[]
+{
+  Bounds3 b = boundingBox();
+  vec3 p1;
+  vec3 p2;
+
+  for (int i = 0; i < 3; i++)
+  {
+    p1[i] = dMax(b.getMin()[i], box.getMin()[i]);
+    p2[i] = dMin(b.getMax()[i], box.getMax()[i]);
+    if (p1[i] > p2[i])
+      return Bounds3();
+  }
+  return Bounds3(p1, p2);
+}
+
 const mat4&
 Model::getLocalToWorldMatrix() const
 //[]---------------------------------------------------[]
@@ -101,16 +124,13 @@ ModelInstance::triangleMesh() const
 
 bool
 ModelInstance::intersect(const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Intersect                                          |
+//[]---------------------------------------------------[]
 {
-  Ray localRay(ray, worldToLocal);
-  REAL d = Math::inverse(localRay.direction.length());
-
-  localRay.direction *= d;
-  if (!model->intersect(localRay, hit))
-    return false;
-  hit.distance *= d;
-  hit.object = this;
-  return true;
+  // The local direction is not normalized, so hit.distance (and
+  // ray.maxD) are valid in both spaces
+  return model->intersect(Ray(ray, rayTransform), hit);
 }
 
 vec3
@@ -119,8 +139,21 @@ ModelInstance::normal(const Intersection& hit) const
 //|  Normal                                             |
 //[]---------------------------------------------------[]
 {
-  vec3 N = hit.triangle->normal(hit);
-  return localToWorld.transformVector(N).versor();
+  vec3 N = model->normal(hit);
+
+  // Normals go by the transposed inverse, which keeps them
+  // perpendicular to the surface under non-uniform scales
+  return mat3(worldToLocal).transposeTransform(N).versor();
+}
+
+void
+ModelInstance::setTransform(const mat4& m)
+//[]---------------------------------------------------[]
+//|  Set transform                                      |
+//[]---------------------------------------------------[]
+{
+  Primitive::setTransform(m);
+  rayTransform.set(worldToLocal);
 }
 
 Bounds3
@@ -220,11 +253,14 @@ inverseTRS(const mat4& trs)
 }
 
 void
-Primitive::setTransform(const vec3& p, const quat& q, const vec3& s)
+Primitive::setTransform(const mat4& m)
 //[]---------------------------------------------------[]
 //|  Set transform                                      |
+//|  m must be a rotation and scale followed by a       |
+//|  translation, as the matrices made by mat4::TRS()   |
+//|  and their products with uniform scales             |
 //[]---------------------------------------------------[]
 {
-  localToWorld = mat4::TRS(p, q, s);
+  localToWorld = m;
   worldToLocal = inverseTRS(localToWorld);
 }
@@ -0,0 +1,686 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: PagedMesh.cpp
+//  ========
+//  Source file for out-of-core paged mesh.
+
+#include <algorithm>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+#include "MeshFile.h"
+#include "PagedMesh.h"
+
+using namespace Graphics;
+
+#define PAGED_MESH_BYTE_ORDER 0x01020304u
+
+inline uint64_t
+alignOffset(uint64_t offset)
+{
+  return (offset + MESH_FILE_ALIGNMENT - 1) & ~uint64_t(MESH_FILE_ALIGNMENT - 1);
+}
+
+// Distance at which a ray enters a box, or ray.minD if the ray starts
+// inside it (Bounds3::intersect() gives the exit distance instead)
+static bool
+enterBox(const Bounds3& b, const Ray& ray, const vec3& invDir, REAL& d)
+{
+  REAL t0 = ray.minD;
+  REAL t1 = ray.maxD;
+
+  for (int i = 0; i < 3; i++)
+  {
+    REAL tNear = (b.getMin()[i] - ray.origin[i]) * invDir[i];
+    REAL tFar = (b.getMax()[i] - ray.origin[i]) * invDir[i];
+
+    if (tNear > tFar)
+      dSwap(tNear, tFar);
+    if (tNear > t0)
+      t0 = tNear;
+    if (tFar < t1)
+      t1 = tFar;
+    if (t0 > t1)
+      return false;
+  }
+  d = t0;
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// ChunkMesh: triangle mesh of a chunk in a mapped file
+// =========
+class ChunkMesh: public TriangleMesh
+{
+public:
+  // Constructor
+  ChunkMesh(const Arrays& a):
+    TriangleMesh(a)
+  {
+    // do nothing
+  }
+
+  // Destructor
+  ~ChunkMesh()
+  {
+    // The arrays are in the mapping, which is read-only
+    data.vertices = 0;
+    data.normals = 0;
+    data.vertexColors = 0;
+    data.triangles = 0;
+  }
+
+}; // ChunkMesh
+
+
+//////////////////////////////////////////////////////////
+//
+// PagedMeshWriter: paged mesh file writer class
+// ===============
+//
+// Splits the triangles of a mesh at the median of their centers along
+// the longest axis until they fit in a chunk. Chunks are written as
+// soon as they are made, in the order of the triangles, and the tree
+// of splits becomes the chunk tree of the file.
+//
+class PagedMeshWriter
+{
+public:
+  // Constructor
+  PagedMeshWriter(const TriangleMesh::Arrays& a, int n, FILE* f):
+    data(a),
+    chunkSize(n),
+    file(f),
+    size(0),
+    ok(true)
+  {
+    // do nothing
+  }
+
+  bool write();
+
+private:
+  const TriangleMesh::Arrays& data;
+  int chunkSize;
+  FILE* file;
+  uint64_t size;
+  bool ok;
+  std::vector<int> triangles;
+  std::vector<PagedMesh::Chunk> chunks;
+  std::vector<BVHNode> nodes;
+
+  vec3 center(int t) const
+  {
+    return triangleCenter(data.vertices, data.triangles[t].v);
+  }
+
+  uint64_t put(const void*, size_t);
+  int32 split(int, int, int32);
+  void writeChunk(int, int, PagedMesh::Chunk&);
+
+}; // PagedMeshWriter
+
+uint64_t
+PagedMeshWriter::put(const void* p, size_t length)
+//[]---------------------------------------------------[]
+//|  Put                                                |
+//|  Writes an array at the next aligned offset         |
+//[]---------------------------------------------------[]
+{
+  // Empty arrays are absent and take no space
+  if (length == 0 || !ok)
+    return 0;
+
+  static const char zeros[MESH_FILE_ALIGNMENT] = {0};
+  uint64_t offset = alignOffset(size);
+
+  ok = fwrite(zeros, 1, (size_t)(offset - size), file) == offset - size &&
+    fwrite(p, 1, length, file) == length;
+  size = offset + length;
+  return offset;
+}
+
+void
+PagedMeshWriter::writeChunk(int begin, int end, PagedMesh::Chunk& c)
+//[]---------------------------------------------------[]
+//|  Write chunk                                        |
+//|  Writes triangles [begin, end) as a mesh with its   |
+//|  own vertices                                       |
+//[]---------------------------------------------------[]
+{
+  std::unordered_map<int, int> local;
+  std::vector<vec3> vertices;
+  std::vector<vec3> normals;
+  std::vector<Color> colors;
+  std::vector<TriangleMesh::Triangle> t(end - begin);
+  Bounds3 bounds;
+
+  for (int i = begin; i < end; i++)
+  {
+    const int* v = data.triangles[triangles[i]].v;
+
+    for (int k = 0; k < 3; k++)
+    {
+      auto e = local.emplace(v[k], (int)vertices.size());
+
+      if (e.second)
+      {
+        vertices.push_back(data.vertices[v[k]]);
+        bounds.inflate(vertices.back());
+        if (data.normals != 0)
+          normals.push_back(data.normals[v[k]]);
+        if (data.vertexColors != 0)
+          colors.push_back(data.vertexColors[v[k]]);
+      }
+      t[i - begin].v[k] = e.first->second;
+    }
+  }
+  c = PagedMesh::Chunk();
+  c.p1 = bounds.getMin();
+  c.p2 = bounds.getMax();
+  c.firstTriangle = begin;
+  c.numberOfVertices = (int32_t)vertices.size();
+  c.numberOfNormals = (int32_t)normals.size();
+  c.numberOfVertexColors = (int32_t)colors.size();
+  c.numberOfTriangles = end - begin;
+  c.vertices = put(vertices.data(), vertices.size() * sizeof(vec3));
+  c.normals = put(normals.data(), normals.size() * sizeof(vec3));
+  c.vertexColors = put(colors.data(), colors.size() * sizeof(Color));
+  c.triangles = put(t.data(), t.size() * sizeof(TriangleMesh::Triangle));
+  c.end = size;
+}
+
+int32
+PagedMeshWriter::split(int begin, int end, int32 level)
+//[]---------------------------------------------------[]
+//|  Split                                              |
+//|  Returns the index of the node of [begin, end)      |
+//[]---------------------------------------------------[]
+{
+  int32 index = (int32)nodes.size();
+  Bounds3 centers;
+
+  nodes.push_back(BVHNode());
+  for (int i = begin; i < end; i++)
+    centers.inflate(center(triangles[i]));
+  if (end - begin <= chunkSize || level == BVH_MAX_LEVEL)
+  {
+    int32 c = (int32)chunks.size();
+
+    chunks.push_back(PagedMesh::Chunk());
+    writeChunk(begin, end, chunks.back());
+    (Bounds3&)nodes[index] = Bounds3(chunks.back().p1, chunks.back().p2);
+    nodes[index].begin(c);
+    nodes[index].end(c);
+    return index;
+  }
+
+  vec3 s = centers.size();
+  int axis = s.x > s.y ? (s.x > s.z ? 0 : 2) : (s.y > s.z ? 1 : 2);
+  int mid = begin + (end - begin) / 2;
+
+  std::nth_element(triangles.begin() + begin,
+    triangles.begin() + mid,
+    triangles.begin() + end,
+    [this, axis](int a, int b)
+    {
+      return center(a)[axis] < center(b)[axis];
+    });
+
+  int32 l = split(begin, mid, level + 1);
+  int32 r = split(mid, end, level + 1);
+  Bounds3 bounds(nodes[l]);
+
+  bounds.inflate(nodes[r]);
+  (Bounds3&)nodes[index] = bounds;
+  nodes[index].lChild(l);
+  nodes[index].rChild(r);
+  return index;
+}
+
+bool
+PagedMeshWriter::write()
+//[]---------------------------------------------------[]
+//|  Write                                              |
+//[]---------------------------------------------------[]
+{
+  PagedMesh::Header h;
+
+  memset(&h, 0, sizeof(h));
+  ok = fwrite(&h, sizeof(h), 1, file) == 1;
+  size = sizeof(h);
+  triangles.resize(data.numberOfTriangles);
+  for (int i = 0; i < data.numberOfTriangles; i++)
+    triangles[i] = i;
+  if (data.numberOfTriangles > 0)
+    split(0, data.numberOfTriangles, 0);
+
+  memcpy(h.magic, PAGED_MESH_MAGIC, 4);
+  h.version = PAGED_MESH_VERSION;
+  h.byteOrder = PAGED_MESH_BYTE_ORDER;
+  h.realSize = sizeof(REAL);
+  h.numberOfChunks = (int32_t)chunks.size();
+  h.numberOfNodes = (int32_t)nodes.size();
+  h.numberOfTriangles = data.numberOfTriangles;
+  h.chunks = put(chunks.data(), chunks.size() * sizeof(PagedMesh::Chunk));
+  h.nodes = put(nodes.data(), nodes.size() * sizeof(BVHNode));
+  h.size = size;
+  return ok && fseek(file, 0, SEEK_SET) == 0 &&
+    fwrite(&h, sizeof(h), 1, file) == 1;
+}
+
+static bool
+validArray(const MappedFile& file, uint64_t offset, int n, size_t elementSize)
+{
+  if (offset == 0)
+    return n == 0;
+  return n >= 0 && offset % MESH_FILE_ALIGNMENT == 0 &&
+    offset <= file.size() && (file.size() - offset) / elementSize >= (size_t)n;
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// PagedMesh implementation
+// =========
+PagedMesh::PagedMesh():
+  header(0),
+  chunks(0),
+  nodes(0),
+  budget(PAGED_MESH_BUDGET),
+  residentSize(0),
+  clock(0),
+  pageIns(0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+bool
+PagedMesh::write(const char* fileName,
+  const TriangleMesh::Arrays& data,
+  int chunkSize)
+//[]---------------------------------------------------[]
+//|  Write                                              |
+//|  The arrays are read chunk by chunk, so they can be |
+//|  those of a mapped .bmesh larger than memory        |
+//[]---------------------------------------------------[]
+{
+  FILE* file = fopen(fileName, "wb");
+
+  if (file == 0)
+    return false;
+
+  bool ok = PagedMeshWriter(data, dMax(chunkSize, 1), file).write();
+
+  return fclose(file) == 0 && ok;
+}
+
+PagedMesh*
+PagedMesh::open(const char* fileName, size_t budget)
+//[]---------------------------------------------------[]
+//|  Open                                               |
+//[]---------------------------------------------------[]
+{
+  std::unique_ptr<PagedMesh> mesh(new PagedMesh());
+  MappedFile& file = mesh->file;
+
+  // Chunks and nodes are read where rays hit them
+  if (!file.open(fileName, false, MappedFile::Random) ||
+    file.size() < sizeof(Header))
+    return 0;
+
+  const Header& h = *(const Header*)file.data();
+  bool ok = memcmp(h.magic, PAGED_MESH_MAGIC, 4) == 0 &&
+    h.version == PAGED_MESH_VERSION &&
+    h.byteOrder == PAGED_MESH_BYTE_ORDER &&
+    h.realSize == sizeof(REAL) &&
+    h.size == file.size() &&
+    validArray(file, h.chunks, h.numberOfChunks, sizeof(Chunk)) &&
+    validArray(file, h.nodes, h.numberOfNodes, sizeof(BVHNode));
+
+  if (ok)
+  {
+    mesh->header = &h;
+    mesh->chunks = (const Chunk*)(file.data() + h.chunks);
+    mesh->nodes = (const BVHNode*)(file.data() + h.nodes);
+  }
+  // Chunks are in the order of their triangles and each one has its
+  // arrays in the file
+  for (int32 i = 0, first = 0; ok && i < h.numberOfChunks; i++)
+  {
+    const Chunk& c = mesh->chunks[i];
+
+    ok = c.firstTriangle == first &&
+      c.numberOfVertices > 0 &&
+      c.numberOfTriangles > 0 &&
+      validArray(file, c.vertices, c.numberOfVertices, sizeof(vec3)) &&
+      validArray(file, c.normals, c.numberOfNormals, sizeof(vec3)) &&
+      validArray(file, c.vertexColors, c.numberOfVertexColors, sizeof(Color)) &&
+      validArray(file, c.triangles, c.numberOfTriangles,
+        sizeof(TriangleMesh::Triangle)) &&
+      c.vertices < c.end && c.end <= file.size();
+    first += c.numberOfTriangles;
+    if (i == h.numberOfChunks - 1)
+      ok = ok && first == h.numberOfTriangles;
+  }
+  // Children follow their parents, and no leaf is deeper than the
+  // traversal stack allows
+  {
+    std::vector<int32> levels(ok ? h.numberOfNodes : 0, 0);
+
+    for (int32 i = 0; ok && i < h.numberOfNodes; i++)
+    {
+      const BVHNode& node = mesh->nodes[i];
+
+      if (node.lChild() < 0)
+        ok = node.begin() >= 0 && node.begin() <= node.end() &&
+          node.end() < h.numberOfChunks;
+      else
+      {
+        ok = node.lChild() > i && node.lChild() < h.numberOfNodes &&
+          node.rChild() > i && node.rChild() < h.numberOfNodes &&
+          levels[i] < BVH_MAX_LEVEL;
+        if (ok)
+          levels[node.lChild()] = levels[node.rChild()] = levels[i] + 1;
+      }
+    }
+  }
+  if (!ok)
+  {
+    printf("Invalid paged mesh file %s\n", fileName);
+    return 0;
+  }
+  mesh->budget = budget;
+  mesh->pages.resize(h.numberOfChunks);
+  return mesh.release();
+}
+
+bool
+PagedMesh::isPagedMeshFile(const char* fileName)
+//[]---------------------------------------------------[]
+//|  Is paged mesh file                                 |
+//[]---------------------------------------------------[]
+{
+  const char* ext = strrchr(fileName, '.');
+
+  return ext != 0 && strcmp(ext, ".pmesh") == 0;
+}
+
+PagedMesh::Page*
+PagedMesh::pageIn(int i) const
+//[]---------------------------------------------------[]
+//|  Page in                                            |
+//|  Makes the mesh of a chunk and builds its BVH       |
+//[]---------------------------------------------------[]
+{
+  const Chunk& c = chunks[i];
+  char* base = (char*)file.data();
+  TriangleMesh::Arrays a;
+
+  a.numberOfVertices = c.numberOfVertices;
+  a.numberOfNormals = c.numberOfNormals;
+  a.numberOfVertexColors = c.numberOfVertexColors;
+  a.numberOfTriangles = c.numberOfTriangles;
+  a.vertices = (vec3*)(base + c.vertices);
+  a.normals = c.normals != 0 ? (vec3*)(base + c.normals) : 0;
+  a.vertexColors = c.vertexColors != 0 ? (Color*)(base + c.vertexColors) : 0;
+  a.triangles = (TriangleMesh::Triangle*)(base + c.triangles);
+
+  Page* page = new Page();
+  int nt = c.numberOfTriangles;
+
+  page->mesh = new ChunkMesh(a);
+  // The build is deterministic, so a chunk paged in again has the
+  // same BVH, and the hits taken before it was evicted stay valid
+  page->bvh = new BVH(TriangleMeshShape(page->mesh).refine());
+  page->size = (size_t)(c.end - c.vertices) +
+    nt * (sizeof(TriangleShape) + sizeof(ModelPtr)) +
+    page->bvh->size() * sizeof(BVHNode);
+  return page;
+}
+
+void
+PagedMesh::evict(int keep) const
+//[]---------------------------------------------------[]
+//|  Evict                                              |
+//|  Pages out the least recently used chunks but keep  |
+//|  until the resident ones fit in the budget          |
+//[]---------------------------------------------------[]
+{
+  while (residentSize > budget)
+  {
+    int lru = -1;
+
+    for (int i = 0, n = (int)pages.size(); i < n; i++)
+      if (i != keep && pages[i].page != 0 &&
+        (lru < 0 || pages[i].lastUse < pages[lru].lastUse))
+        lru = i;
+    if (lru < 0)
+      break;
+    residentSize -= pages[lru].page->size;
+    pages[lru].page = 0;
+    // The mapping is read-only: its pages are read again when needed
+    file.discard((size_t)chunks[lru].vertices,
+      (size_t)(chunks[lru].end - chunks[lru].vertices));
+  }
+}
+
+ObjectPtr<PagedMesh::Page>
+PagedMesh::page(int i) const
+//[]---------------------------------------------------[]
+//|  Page                                               |
+//|  Returns the resident page of a chunk, paging it in |
+//|  if needed                                          |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+  PageEntry& e = pages[i];
+
+  if (e.page == 0)
+  {
+    e.page = pageIn(i);
+    residentSize += e.page->size;
+    pageIns++;
+    evict(i);
+  }
+  e.lastUse = ++clock;
+  return e.page;
+}
+
+void
+PagedMesh::setBudget(size_t b)
+//[]---------------------------------------------------[]
+//|  Set budget                                         |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  budget = b;
+  evict(-1);
+}
+
+size_t
+PagedMesh::getResidentSize() const
+//[]---------------------------------------------------[]
+//|  Get resident size                                  |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return residentSize;
+}
+
+int
+PagedMesh::getNumberOfPageIns() const
+//[]---------------------------------------------------[]
+//|  Get number of page-ins                             |
+//[]---------------------------------------------------[]
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return pageIns;
+}
+
+bool
+PagedMesh::intersectChunk(int i, const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Intersect chunk                                    |
+//[]---------------------------------------------------[]
+{
+  // The page is held until the ray is done with it
+  ObjectPtr<Page> p = page(i);
+  Intersection h;
+
+  if (!p->bvh->intersect(ray, h) || h.distance >= hit.distance)
+    return false;
+  hit = h;
+  // Triangle index in the whole mesh
+  hit.primitive += chunks[i].firstTriangle;
+  return true;
+}
+
+bool
+PagedMesh::intersect(const Ray& ray, Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Intersect                                          |
+//|  Visits the chunks front to back and skips the ones |
+//|  the ray enters behind the closest hit              |
+//[]---------------------------------------------------[]
+{
+  struct Entry
+  {
+    int32 node;
+    REAL distance;
+  };
+
+  Entry stack[BVH_STACK_SIZE];
+  int32 top = 0;
+  vec3 invDir = ray.direction.inverse();
+  REAL d;
+
+  hit.distance = ray.maxD;
+  hit.primitive = -1;
+  if (header->numberOfNodes == 0 || !enterBox(nodes[0], ray, invDir, d))
+    return false;
+  stack[top++] = {0, d};
+  while (top != 0)
+  {
+    Entry e = stack[--top];
+
+    if (e.distance >= hit.distance)
+      continue;
+
+    const BVHNode& node = nodes[e.node];
+
+    if (node.lChild() < 0)
+    {
+      for (int i = node.begin(), end = node.end(); i <= end; i++)
+        intersectChunk(i, ray, hit);
+      continue;
+    }
+
+    Entry c1 = {node.lChild(), 0};
+    Entry c2 = {node.rChild(), 0};
+    bool enter1 = enterBox(nodes[c1.node], ray, invDir, c1.distance) &&
+      c1.distance < hit.distance;
+    bool enter2 = enterBox(nodes[c2.node], ray, invDir, c2.distance) &&
+      c2.distance < hit.distance;
+
+    if (enter1 && enter2)
+    {
+      if (c2.distance < c1.distance)
+        dSwap(c1, c2);
+      stack[top++] = c2;
+      stack[top++] = c1;
+    }
+    else if (enter1)
+      stack[top++] = c1;
+    else if (enter2)
+      stack[top++] = c2;
+  }
+  return hit.primitive >= 0;
+}
+
+vec3
+PagedMesh::normal(const Intersection& hit) const
+//[]---------------------------------------------------[]
+//|  Normal                                             |
+//[]---------------------------------------------------[]
+{
+  // The chunk of the triangle, paged in again if it was evicted
+  const Chunk* c = std::upper_bound(chunks,
+    chunks + header->numberOfChunks,
+    hit.primitive,
+    [](int32 t, const Chunk& c)
+    {
+      return t < c.firstTriangle;
+    }) - 1;
+  Intersection h = hit;
+
+  h.primitive -= c->firstTriangle;
+  return page(int(c - chunks))->bvh->normal(h);
+}
+
+Bounds3
+PagedMesh::boundingBox() const
+//[]---------------------------------------------------[]
+//|  Bounding box                                       |
+//[]---------------------------------------------------[]
+{
+  return header->numberOfNodes == 0 ? Bounds3() : Bounds3(nodes[0]);
+}
+
+
+//////////////////////////////////////////////////////////
+//
+// PagedMeshShape implementation
+// ==============
+bool
+PagedMeshShape::canIntersect() const
+//[]---------------------------------------------------[]
+//|  Can intersect                                      |
+//[]---------------------------------------------------[]
+{
+  return false;
+}
+
+bool
+PagedMeshShape::intersect(const Ray&, Intersection&) const
+//[]---------------------------------------------------[]
+//|  Intersect                                          |
+//[]---------------------------------------------------[]
+{
+  System::warning("PagedMeshShape::intersect() invoked");
+  return false;
+}
+
+vec3
+PagedMeshShape::normal(const Intersection&) const
+//[]---------------------------------------------------[]
+//|  Normal                                             |
+//[]---------------------------------------------------[]
+{
+  System::warning("PagedMeshShape::normal() invoked");
+  return vec3::null();
+}
+
+Bounds3
+PagedMeshShape::boundingBox() const
+//[]---------------------------------------------------[]
+//|  Bounding box                                       |
+//[]---------------------------------------------------[]
+{
+  return Bounds3(mesh->boundingBox(), localToWorld);
+}
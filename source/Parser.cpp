@@ -136,6 +136,13 @@ Scene* Parser::parseScene(){
 	// processing the objets in the scene
 	xml_object_range<xml_node_iterator> objets = scene.children();
 	Light* light;
+
+	// start reading all the mesh files, concurrently, before the
+	// actors that need them
+	for (xml_node_iterator sceneElement = objets.begin(); sceneElement != objets.end(); ++sceneElement)
+		if (strcmp(sceneElement->name(), "mesh") == 0 &&
+			!PagedMesh::isPagedMeshFile(sceneElement->attribute("file").value()))
+			MeshCache::load(sceneElement->attribute("file").value());
 	for (xml_node_iterator sceneElement = objets.begin(); sceneElement != objets.end(); ++sceneElement) {
 
 		if (strcmp(sceneElement->name(), "mesh") == 0)
@@ -162,6 +169,63 @@ Scene* Parser::parseScene(){
 	return _s;
 }
 
+// Places a shape of radius 1 and height 1 along the y axis, with base
+// (or center) at the origin, as the one with the given radius and
+// height vector and base (or center) at origin
+static mat4
+placeAlongY(const vec3& origin, REAL radius, const vec3& height)
+{
+	const REAL length = height.length();
+	const vec3 axis = vec3::up().cross(height);
+	quat q = quat::identity();
+
+	if (!axis.isNull())
+		q = quat(Math::toDegrees(acos(height.y / length)), axis);
+	else if (height.y < 0)
+		q = quat(180, vec3(1, 0, 0));
+	return mat4::TRS(origin, q, vec3(radius, length, radius));
+}
+
+mat4
+Parser::parseTransform(xml_node op)
+{
+	vec3 position(0, 0, 0);
+	quat q = quat::identity();
+	vec3 scale(1, 1, 1);
+	float x, y, z;
+
+	if (op == NULL)
+		return mat4::identity();
+
+	xml_object_range<xml_node_iterator> transformations = op.children();
+
+	// The children set the parts of one TRS transform, in any order
+	for (xml_node_iterator transformation = transformations.begin(); transformation != transformations.end(); ++transformation)
+	{
+		if (strcmp(transformation->name(), "position") == 0)
+		{
+			const char * stringTranslation = transformation->text().as_string();
+
+			sscanf(stringTranslation, "%f %f %f", &x, &y, &z);
+			position.set(x, y, z);
+		}
+		else if (strcmp(transformation->name(), "scale") == 0)
+		{
+			float s_ = transformation->text().as_float();
+			scale.set(s_, s_, s_);
+		}
+		else if (strcmp(transformation->name(), "rotation") == 0)
+		{
+			float angle = transformation->child("angle").text().as_float();
+
+			const char * _Axis = transformation->child("axis").text().as_string();
+			sscanf(_Axis, "%f %f %f", &x, &y, &z);
+			q = quat(angle, vec3(x, y, z));
+		}
+	}
+	return mat4::TRS(position, q, scale);
+}
+
 Actor*
 Parser::parseCylinder(xml_node_iterator sceneElement)
 {
@@ -195,48 +259,11 @@ Parser::parseCylinder(xml_node_iterator sceneElement)
 	if (op != NULL)
 		segments = op.text().as_int();
 
-	// now, lets make the mesh of Sphere
-	TriangleMesh* cylinderMesh = MeshSweeper::makeCylinder(center, radius, height, segments);
+	// All cylinders with the same number of segments share one mesh
+	Primitive* primitive = new AnalyticShape(AnalyticShape::Cylinder, MeshCache::getCylinder(segments));
 
-	Primitive* primitive = new TriangleMeshShape(cylinderMesh);
-
-	if ((op = sceneElement->child("transform")) != NULL) {
-		vec3 position(0, 0, 0);
-		quat q(vec3(0, 0, 0));
-		vec3 scale(1, 1, 1);
-		float x, y, z;
-
-		xml_object_range<xml_node_iterator> transformations = op.children();
-
-		for (xml_node_iterator transformation = transformations.begin(); transformation != transformations.end(); ++transformation)
-		{
-			if (strcmp(transformation->name(), "position") == 0)
-			{
-				const char * stringTranslation = transformation->text().as_string();
-
-				sscanf(stringTranslation, "%f %f %f", &x, &y, &z);
-				vec3 translationVec(x, y, z);
-				position = translationVec;
-			}
-			else if (strcmp(transformation->name(), "scale") == 0)
-			{
-				float s_ = transformation->text().as_float();
-				vec3 newS(s_, s_, s_);
-				scale = newS;
-			}
-			else if (strcmp(transformation->name(), "rotation") == 0)
-			{
-				float angle = transformation->child("angle").text().as_float();
-
-				const char * _Axis = transformation->child("axis").text().as_string();
-				sscanf(_Axis, "%f %f %f", &x, &y, &z);
-				vec3 axis(x, y, z);
-				q = quat(axis, angle);
-			}
-
-			cylinderMesh->transform(mat4::TRS(position, q, scale));
-		}
-	}
+	primitive->setTransform(parseTransform(sceneElement->child("transform")) *
+		placeAlongY(center, radius, height));
 	if ((op = sceneElement->child("material")) != NULL) {
 		Material * material = parseMaterial(op);
 		primitive->setMaterial(material);
@@ -287,48 +314,11 @@ Parser::parseCone(xml_node_iterator sceneElement)
 	if (op != NULL)
 		segments = op.text().as_int();
 
-	// now, lets make the mesh of Sphere
-	TriangleMesh* coneMesh = MeshSweeper::makeCone(center, radius, height, segments);
-
-	Primitive* primitive = new TriangleMeshShape(coneMesh);
-
-	if ((op = sceneElement->child("transform")) != NULL) {
-		vec3 position(0, 0, 0);
-		quat q(vec3(0, 0, 0));
-		vec3 scale(1, 1, 1);
-		float x, y, z;
-
-		xml_object_range<xml_node_iterator> transformations = op.children();
-
-		for (xml_node_iterator transformation = transformations.begin(); transformation != transformations.end(); ++transformation)
-		{
-			if (strcmp(transformation->name(), "position") == 0)
-			{
-				const char * stringTranslation = transformation->text().as_string();
-
-				sscanf(stringTranslation, "%f %f %f", &x, &y, &z);
-				vec3 translationVec(x, y, z);
-				position = translationVec;
-			}
-			else if (strcmp(transformation->name(), "scale") == 0)
-			{
-				float s_ = transformation->text().as_float();
-				vec3 newS(s_, s_, s_);
-				scale = newS;
-			}
-			else if (strcmp(transformation->name(), "rotation") == 0)
-			{
-				float angle = transformation->child("angle").text().as_float();
-
-				const char * _Axis = transformation->child("axis").text().as_string();
-				sscanf(_Axis, "%f %f %f", &x, &y, &z);
-				vec3 axis(x, y, z);
-				q = quat(axis, angle);
-			}
+	// All cones with the same number of segments share one mesh
+	Primitive* primitive = new AnalyticShape(AnalyticShape::Cone, MeshCache::getCone(segments));
 
-			coneMesh->transform(mat4::TRS(position, q, scale));
-		}
-	}
+	primitive->setTransform(parseTransform(sceneElement->child("transform")) *
+		placeAlongY(center, radius, height));
 	if ((op = sceneElement->child("material")) != NULL) {
 		Material * material = parseMaterial(op);
 		primitive->setMaterial(material);
@@ -350,7 +340,7 @@ Actor*
 Parser::parseBox(xml_node_iterator sceneElement)
 {
 	vec3 center(0, 0, 0);
-	quat orientation(vec3(0, 0, 0));
+	quat orientation = quat::identity();
 	vec3 scale(1, 1, 1);
 
 	// opt values
@@ -369,7 +359,7 @@ Parser::parseBox(xml_node_iterator sceneElement)
 		const char* orientation_vec = op.text().as_string();
 
 		sscanf(orientation_vec, "%f %f %f", &x, &y, &z);
-		orientation.eulerAngles(vec3(x, y, z));
+		orientation = quat::eulerAngles(vec3(x, y, z));
 	}
 	op = sceneElement->child("scale");
 	if (op != NULL){
@@ -379,48 +369,11 @@ Parser::parseBox(xml_node_iterator sceneElement)
 		scale.set(vec3(x, y, z));
 	}
 
-	// now, lets make the mesh of Sphere
-	TriangleMesh* boxMesh = MeshSweeper::makeBox(center, orientation, scale);
-
-	Primitive* primitive = new TriangleMeshShape(boxMesh);
-
-	if ((op = sceneElement->child("transform")) != NULL) {
-		vec3 position(0, 0, 0);
-		quat q(vec3(0, 0, 0));
-		vec3 scale(1, 1, 1);
-		float x, y, z;
-
-		xml_object_range<xml_node_iterator> transformations = op.children();
-
-		for (xml_node_iterator transformation = transformations.begin(); transformation != transformations.end(); ++transformation)
-		{
-			if (strcmp(transformation->name(), "position") == 0)
-			{
-				const char * stringTranslation = transformation->text().as_string();
-
-				sscanf(stringTranslation, "%f %f %f", &x, &y, &z);
-				vec3 translationVec(x, y, z);
-				position = translationVec;
-			}
-			else if (strcmp(transformation->name(), "scale") == 0)
-			{
-				float s_ = transformation->text().as_float();
-				vec3 newS(s_, s_, s_);
-				scale = newS;
-			}
-			else if (strcmp(transformation->name(), "rotation") == 0)
-			{
-				float angle = transformation->child("angle").text().as_float();
-
-				const char * _Axis = transformation->child("axis").text().as_string();
-				sscanf(_Axis, "%f %f %f", &x, &y, &z);
-				vec3 axis(x, y, z);
-				q = quat(axis, angle);
-			}
+	// All boxes share one mesh
+	Primitive* primitive = new AnalyticShape(AnalyticShape::Box, MeshCache::getBox());
 
-			boxMesh->transform(mat4::TRS(position, q, scale));
-		}
-	}
+	primitive->setTransform(parseTransform(sceneElement->child("transform")) *
+		mat4::TRS(center, orientation, scale));
 	if ((op = sceneElement->child("material")) != NULL) {
 		Material * material = parseMaterial(op);
 		primitive->setMaterial(material);
@@ -463,48 +416,11 @@ Actor* Parser::parseSphere(xml_node_iterator sceneElement)
 	if (op != NULL)
 		meridians = op.text().as_int();
 
-	// now, lets make the mesh of Sphere
-	TriangleMesh* sphereMesh = MeshSweeper::makeSphere(center, radius, meridians);
-
-	Primitive* primitive = new TriangleMeshShape(sphereMesh);
+	// All spheres with the same number of meridians share one mesh
+	Primitive* primitive = new AnalyticShape(AnalyticShape::Sphere, MeshCache::getSphere(meridians));
 
-	if ((op = sceneElement->child("transform")) != NULL) {
-		vec3 position(0, 0, 0);
-		quat q(vec3(0, 0, 0));
-		vec3 scale(1, 1, 1);
-		float x, y, z;
-
-		xml_object_range<xml_node_iterator> transformations = op.children();
-
-		for (xml_node_iterator transformation = transformations.begin(); transformation != transformations.end(); ++transformation)
-		{
-			if (strcmp(transformation->name(), "position") == 0)
-			{
-				const char * stringTranslation = transformation->text().as_string();
-
-				sscanf(stringTranslation, "%f %f %f", &x, &y, &z);
-				vec3 translationVec(x, y, z);
-				position = translationVec;
-			}
-			else if (strcmp(transformation->name(), "scale") == 0)
-			{
-				float s_ = transformation->text().as_float();
-				vec3 newS(s_, s_, s_);
-				scale = newS;
-			}
-			else if (strcmp(transformation->name(), "rotation") == 0)
-			{
-				float angle = transformation->child("angle").text().as_float();
-
-				const char * _Axis = transformation->child("axis").text().as_string();
-				sscanf(_Axis, "%f %f %f", &x, &y, &z);
-				vec3 axis(x, y, z);
-				q = quat(axis, angle);
-			}
-
-			sphereMesh->transform(mat4::TRS(position, q, scale));
-		}
-	}
+	primitive->setTransform(parseTransform(sceneElement->child("transform")) *
+		mat4::TRS(center, quat::identity(), vec3(radius, radius, radius)));
 	if ((op = sceneElement->child("material")) != NULL) {
 		Material * material = parseMaterial(op);
 		primitive->setMaterial(material);
@@ -609,48 +525,33 @@ Actor* Parser::parseMesh(xml_node_iterator sceneElement)
 	// setting the mesh
 	const char* filename = sceneElement->attribute("file").value();
 
-	TriangleMesh* mesh = MeshReader().execute(filename);
-
-	Primitive* primitive = new TriangleMeshShape(mesh);
+	Primitive* primitive;
 
-	xml_node op;
-	if ((op = sceneElement->child("transform")) != NULL) {
-		vec3 position(0, 0, 0);
-		quat q(vec3(0, 0, 0));
-		vec3 scale(1, 1, 1);
-		float x, y, z;
-
-		xml_object_range<xml_node_iterator> transformations = op.children();
-
-		for (xml_node_iterator transformation = transformations.begin(); transformation != transformations.end(); ++transformation)
-		{
-			if (strcmp(transformation->name(), "position") == 0)
-			{
-				const char * stringTranslation = transformation->text().as_string();
+	if (PagedMesh::isPagedMeshFile(filename))
+	{
+		// Out-of-core mesh, with an optional budget (in MB) for its
+		// resident chunks
+		xml_attribute budget = sceneElement->attribute("budget");
+		PagedMesh* mesh = PagedMesh::open(filename, budget ?
+			size_t(budget.as_double() * 1024 * 1024) : PAGED_MESH_BUDGET);
 
-				sscanf(stringTranslation, "%f %f %f", &x, &y, &z);
-				vec3 translationVec(x, y, z);
-				position = translationVec;
-			}
-			else if (strcmp(transformation->name(), "scale") == 0)
-			{
-				float s_ = transformation->text().as_float();
-				vec3 newS(s_, s_, s_);
-				scale = newS;
-			}
-			else if (strcmp(transformation->name(), "rotation") == 0)
-			{
-				float angle = transformation->child("angle").text().as_float();
-
-				const char * _Axis = transformation->child("axis").text().as_string();
-				sscanf(_Axis, "%f %f %f", &x, &y, &z);
-				vec3 axis(x, y, z);
-				q = quat(axis, angle);
-			}
+		if (mesh == 0)
+			return 0;
+		primitive = new PagedMeshShape(mesh);
+	}
+	else
+	{
+		// Actors of the same file share its mesh; each one is placed by
+		// the transform of its own primitive
+		TriangleMesh* mesh = MeshCache::get(filename);
 
-			mesh->transform(mat4::TRS(position, q, scale));
-		}
+		if (mesh == 0)
+			return 0;
+		primitive = new TriangleMeshShape(mesh);
 	}
+
+	xml_node op;
+	primitive->setTransform(parseTransform(sceneElement->child("transform")));
 	if ((op = sceneElement->child("material")) != NULL) {
 		Material * material = parseMaterial(op);
 		primitive->setMaterial(material);
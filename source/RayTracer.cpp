@@ -14,7 +14,9 @@
 
 #include <map>
 #include <time.h>
+#include "AnalyticShape.h"
 #include "BVH.h"
+#include "ThreadPool.h"
 #include "RayTracer.h"
 #include "algorithm"
 #include <stdlib.h>
@@ -36,62 +38,224 @@ printElapsedTime(const char* s, clock_t time)
 //
 // RayTracer implementation
 // =========
-RayTracer::RayTracer(Scene& scene, Camera* camera) :
+RayTracer::RayTracer(Scene& scene, Camera* camera, const Options& o) :
 Renderer(scene, camera),
+options(o),
 maxRecursionLevel(6),
-minWeight(MIN_WEIGHT)
+minWeight(MIN_WEIGHT),
+passes(0)
 //[]---------------------------------------------------[]
 //|  Constructor                                        |
 //[]---------------------------------------------------[]
 {
-	// TODO: UNCOMMENT THE CODE BELOW
-
 	int n = scene.getNumberOfActors();
 
 	printf("Building aggregates for %d actors...\n", n);
 
 	clock_t t = clock();
-	Array<ModelPtr> models(n);
-	map<uint, ModelPtr> aggregates;
-	string actorNames;
-	int totalNodes = 0;
 	int i = 1;
 
+	aggregate = new DynamicBVH(2 * n);
+	totalNodes = 0;
+	buildAggregates(scene);
 	for (ActorIterator ait(scene.getActorIterator()); ait; i++)
 	{
 		const Actor* a = ait++;
 
 		printf("Processing actor %d/%d...\n", i, n);
-		if (!a->isVisible())
-			continue;
 
-		Primitive* p = dynamic_cast<Primitive*>(a->getModel());
-		const TriangleMesh* mesh = p->triangleMesh();
-		// checking if the id already exists in idList
+		Model* instance = makeInstance(a);
 
-		if (mesh != 0)	
+		if (instance != 0)
+			proxies[a] = aggregate->insert(instance);
+	}
+	if (options.lazyBuild)
+		printf("BVH(s) of %d mesh(es) to be built on demand\n",
+			(int)aggregates.size());
+	else
+		printf("BVH(s) built: %d (%d nodes, %.1f MB in arena)\n",
+			(int)aggregates.size() + 1, totalNodes + aggregate->size(),
+			arena.size() / (1024.0 * 1024.0));
+	printElapsedTime("", clock() - t);
+	for (auto& a : aggregates)
+		if (BVH* bvh = a.second->getBVH())
 		{
-			ModelPtr& a = aggregates[mesh->id];
+			char name[32];
 
-			BVH* bvh = new BVH(std::move(p->refine()));
+			sprintf(name, "Mesh %u BVH", a.first);
+			bvh->getStatistics().print(name);
+		}
+	aggregate->getStatistics().print("Scene BVH");
+	scene.addListener(this);
+}
 
-			totalNodes += bvh->size();
-			a = bvh;
+RayTracer::~RayTracer()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+	scene->removeListener(this);
+}
+
+Primitive*
+RayTracer::meshPrimitive(const Actor* a)
+//[]---------------------------------------------------[]
+//|  Mesh primitive                                     |
+//|  Returns the primitive of a visible actor whose     |
+//|  mesh needs a BVH                                   |
+//[]---------------------------------------------------[]
+{
+	if (!a->isVisible())
+		return 0;
+
+	Primitive* p = dynamic_cast<Primitive*>(a->getModel());
+
+	// Basic shapes are intersected exactly, not by their tessellation
+	if (p == 0 || dynamic_cast<const AnalyticShape*>(p) != 0)
+		return 0;
+	return p->triangleMesh() != 0 ? p : 0;
+}
+
+LazyBVH*
+RayTracer::makeAggregate(Primitive* p)
+//[]---------------------------------------------------[]
+//|  Make aggregate                                     |
+//|  Makes the (not yet built) BVH of the mesh of a     |
+//|  primitive, in the local space of the mesh          |
+//[]---------------------------------------------------[]
+{
+	if (!options.compactMeshes)
+		return new LazyBVH(*p, options.bvh, &arena);
 
-			models.add(new ModelInstance(*a, *p));
-			
+	auto mesh = new CompactMesh(p->triangleMesh()->getData());
+
+	return new LazyBVH(*new CompactMeshShape(mesh), options.bvh, &arena);
+}
+
+void
+RayTracer::buildAggregates(Scene& scene)
+//[]---------------------------------------------------[]
+//|  Build aggregates                                   |
+//|  Makes the BVHs of the meshes of the scene and,     |
+//|  unless they are built on demand, builds each one   |
+//|  by a task of the default thread pool               |
+//[]---------------------------------------------------[]
+{
+	ThreadPool& pool = ThreadPool::getDefault();
+	std::vector<std::future<void>> builds;
+
+	for (ActorIterator ait(scene.getActorIterator()); ait;)
+	{
+		Primitive* p = meshPrimitive(ait++);
+
+		if (p == 0)
+			continue;
+
+		ObjectPtr<LazyBVH>& bvh = aggregates[p->triangleMesh()->id];
+
+		if (bvh != 0)
+			continue;
+		bvh = makeAggregate(p);
+		if (!options.lazyBuild)
+		{
+			LazyBVH* b = bvh;
+
+			builds.push_back(pool.run([b]() { b->build(); }));
 		}
 	}
-	printf("Building scene aggregate...\n");
+	for (auto& b : builds)
+		pool.wait(b);
+	for (auto& a : aggregates)
+		if (BVH* bvh = a.second->getBVH())
+			totalNodes += bvh->size();
+}
+
+Model*
+RayTracer::makeInstance(const Actor* a)
+//[]---------------------------------------------------[]
+//|  Make instance                                      |
+//|  Returns the top-level model of a visible actor,    |
+//|  making the BVH of its mesh only the first time the |
+//|  mesh is seen                                       |
+//[]---------------------------------------------------[]
+{
+	if (!a->isVisible())
+		return 0;
+	if (auto s = dynamic_cast<const AnalyticShape*>(a->getModel()))
+		return new ModelInstance(*s->getShape(), *s);
+	// Paged meshes are their own aggregates
+	if (auto s = dynamic_cast<const PagedMeshShape*>(a->getModel()))
+		return new ModelInstance(*s->getPagedMesh(), *s);
+
+	Primitive* p = meshPrimitive(a);
+
+	if (p == 0)
+		return 0;
+
+	ObjectPtr<LazyBVH>& bvh = aggregates[p->triangleMesh()->id];
+
+	if (bvh == 0)
 	{
-		BVH* bvh = new BVH(std::move(models));
+		bvh = makeAggregate(p);
+		if (!options.lazyBuild)
+			totalNodes += bvh->build()->size();
+	}
+	return new ModelInstance(*bvh, *p);
+}
+
+void
+RayTracer::actorAdded(Scene&, Actor* a)
+//[]---------------------------------------------------[]
+//|  Actor added                                        |
+//[]---------------------------------------------------[]
+{
+	Model* instance = makeInstance(a);
+
+	if (instance != 0)
+		proxies[a] = aggregate->insert(instance);
+	passes = 0;
+}
 
-		totalNodes += bvh->size();
-		aggregate = bvh;
+void
+RayTracer::actorRemoved(Scene&, Actor* a)
+//[]---------------------------------------------------[]
+//|  Actor removed                                      |
+//[]---------------------------------------------------[]
+{
+	auto pit = proxies.find(a);
+
+	if (pit != proxies.end())
+	{
+		aggregate->remove(pit->second);
+		proxies.erase(pit);
 	}
-	printf("BVH(s) built: %d (%d nodes)\n", aggregates.size() + 1, totalNodes);
-	printElapsedTime("", clock() - t);
+	passes = 0;
+}
+
+void
+RayTracer::actorModified(Scene&, Actor* a)
+//[]---------------------------------------------------[]
+//|  Actor modified                                     |
+//|  Only the leaf of the actor is reinserted into the  |
+//|  top-level BVH; mesh BVHs are reused                |
+//[]---------------------------------------------------[]
+{
+	Model* instance = makeInstance(a);
+	auto pit = proxies.find(a);
 
+	if (pit == proxies.end())
+	{
+		if (instance != 0)
+			proxies[a] = aggregate->insert(instance);
+	}
+	else if (instance != 0)
+		aggregate->update(pit->second, instance);
+	else
+	{
+		aggregate->remove(pit->second);
+		proxies.erase(pit);
+	}
+	passes = 0;
 }
 
 //
@@ -129,6 +293,65 @@ RayTracer::renderImage(Image& image, bool isAdaptative)
 {
 	clock_t t = clock();
 
+	compileScene();
+	setView(image);
+	if (isAdaptative)
+	{
+		passes = 0;
+		adaptativeScan(image);
+	}
+	else
+		scan(image);
+	printf("\nNumber of rays: %lu", numberOfRays);
+	printf("\nNumber of hits: %lu", numberOfHits);
+	printElapsedTime("\nDONE! ", clock() - t);
+}
+
+void
+RayTracer::refineImage(Image& image, int n)
+//[]---------------------------------------------------[]
+//|  Refine the last image                              |
+//|  @param the image                                   |
+//|  @param number of sample passes to add              |
+//[]---------------------------------------------------[]
+{
+	clock_t t = clock();
+
+	compileScene();
+	setView(image);
+	numberOfRays = numberOfHits = 0;
+	if (n <= 0)
+		accumulation.write(image);
+	else
+	{
+		// the rows of the image are written as the last pass ends them
+		for (int last = passes + n - 1; passes < last;)
+			addPass();
+		addPass(&image);
+	}
+	printf("\nNumber of passes: %d", passes);
+	printf("\nNumber of rays: %lu", numberOfRays);
+	printElapsedTime("\nDONE! ", clock() - t);
+}
+
+void
+RayTracer::compileScene()
+//[]---------------------------------------------------[]
+//|  Compile scene                                      |
+//|  Takes the snapshot of the lights and materials     |
+//|  read by shade()                                    |
+//[]---------------------------------------------------[]
+{
+	renderScene.compile(*scene, *aggregate, proxies);
+}
+
+void
+RayTracer::setView(Image& image)
+//[]---------------------------------------------------[]
+//|  Set view                                           |
+//|  Init the mapping from image to VRC                 |
+//[]---------------------------------------------------[]
+{
 	image.getSize(W, H);
 	// init auxiliary VRC
 	VRC_n = camera->getViewPlaneNormal();
@@ -141,13 +364,6 @@ RayTracer::renderImage(Image& image, bool isAdaptative)
 	REAL height = camera->windowHeight();
 
 	W >= H ? V_w = (V_h = height) * W * I_h : V_h = (V_w = height) * H * I_w;
-	if (isAdaptative)
-		adaptativeScan(image);
-	else
-		scan(image);
-	printf("\nNumber of rays: %lu", numberOfRays);
-	printf("\nNumber of hits: %lu", numberOfHits);
-	printElapsedTime("\nDONE! ", clock() - t);
 }
 
 static Ray pixelRay;
@@ -356,41 +572,157 @@ RayTracer::subDivision(int i, int j, REAL sub, int level)
 void
 RayTracer::scan(Image& image)
 //[]---------------------------------------------------[]
-//|  Basic scan with optional jitter                    |
+//|  Basic scan                                         |
+//|  Starts a new accumulation with one sample at the   |
+//|  center of each pixel                               |
 //[]---------------------------------------------------[]
 {
+	numberOfRays = numberOfHits = 0;
+	passes = 0;
+	addPass(&image);
+}
+
+//
+// Radical inverse of i in base b, in [0,1)
+//
+static REAL
+radicalInverse(int i, int b)
+{
+	REAL f = 1, r = 0;
+
+	for (REAL s = Math::inverse<REAL>(REAL(b)); i > 0; i /= b)
+		r += (f *= s) * (i % b);
+	return r;
+}
+
+//
+// Offset in the pixel of the samples of a pass
+//
+inline void
+passOffset(int pass, REAL& dx, REAL& dy)
+{
+	dx = pass == 0 ? REAL(0.5) : radicalInverse(pass, 2);
+	dy = pass == 0 ? REAL(0.5) : radicalInverse(pass, 3);
+}
+
+void
+RayTracer::addPass(Image* image)
+//[]---------------------------------------------------[]
+//|  Add a sample pass                                  |
+//|  Pass 0 samples the center of each pixel and starts |
+//|  the accumulation; pass k > 0 samples the k-th      |
+//|  point of the Halton sequence in base (2,3). Each   |
+//|  row is written to the image, if any, as soon as it |
+//|  is done, in the order the image prefers            |
+//[]---------------------------------------------------[]
+{
+	if (passes == 0 || accumulation.getWidth() != W || accumulation.getHeight() != H)
+	{
+		accumulation.resize(W, H);
+		accumulation.clear();
+		passes = 0;
+	}
+
+	REAL dx, dy;
+
+	passOffset(passes, dx, dy);
+
+	bool topDown = image != 0 && image->isTopDown();
+
 	// init pixel ray
 	pixelRay = Ray(camera->getPosition(), -VRC_n);
+	for (int k = 0; k < H; k++)
+	{
+		int j = topDown ? H - 1 - k : k;
+		REAL y = j + dy;
+
+		printf("Scanning line %d of %d\r", k + 1, H);
+		for (int i = 0; i < W; i++)
+			accumulation.add(i, j, sample(i + dx, y));
+		if (image != 0)
+			accumulation.write(*image, j);
+	}
+	passes++;
+}
+
+void
+RayTracer::renderTiles(TiledImage& image, int n)
+//[]---------------------------------------------------[]
+//|  Render tiles                                       |
+//|  @param the image                                   |
+//|  @param number of sample passes                     |
+//[]---------------------------------------------------[]
+{
+	clock_t t = clock();
+
+	compileScene();
+	setView(image);
 	numberOfRays = numberOfHits = 0;
+	// init pixel ray
+	pixelRay = Ray(camera->getPosition(), -VRC_n);
 
-	Pixel* pixels = new Pixel[W];
+	// the samples of a tile, tone mapped as those of a whole image
+	AccumulationBuffer tile;
+	int ts = image.getTileSize();
+	int nt = image.getNumberOfTiles();
+	Pixel* pixels = new Pixel[ts * ts];
 
-	for (int j = 0; j < H; j++)
+	tile.setToneMapping(accumulation.getToneMapping());
+	tile.setExposure(accumulation.getExposure());
+	for (int k = 0; k < nt; k++)
 	{
-		REAL y = j + 0.5f;
+		int x, y, w, h;
 
-		printf("Scanning line %d of %d\r", j + 1, H);
-		for (int i = 0; i < W; i++)
-			pixels[i] = shoot(i + 0.5f, y);
-		image.write(j, pixels);
+		image.getTile(k, x, y, w, h);
+		printf("Rendering tile %d of %d\r", k + 1, nt);
+		tile.resize(w, h);
+		tile.clear();
+		for (int p = 0; p < n; p++)
+		{
+			REAL dx, dy;
+
+			passOffset(p, dx, dy);
+			for (int j = 0; j < h; j++)
+				for (int i = 0; i < w; i++)
+					tile.add(i, j, sample(x + i + dx, y + j + dy));
+		}
+		for (int j = 0; j < h; j++)
+			for (int i = 0; i < w; i++)
+				pixels[j * w + i] = tile.getToneMappedColor(i, j);
+		image.writeTile(k, pixels);
 	}
 	delete[]pixels;
+	printf("\nNumber of rays: %lu", numberOfRays);
+	printf("\nNumber of hits: %lu", numberOfHits);
+	printElapsedTime("\nDONE! ", clock() - t);
 }
 
 Color
-RayTracer::shoot(REAL x, REAL y)
+RayTracer::sample(REAL x, REAL y)
 //[]---------------------------------------------------[]
-//|  Shoot a pixel ray                                  |
+//|  Sample a pixel                                     |
 //|  @param x coordinate of the pixel                   |
 //|  @param y cordinates of the pixel                   |
-//|  @return RGB color of the pixel                     |
+//|  @return unclamped RGB color of the pixel ray       |
 //[]---------------------------------------------------[]
 {
 	// set pixel ray
 	setPixelRay(x, y);
 
 	// trace pixel ray
-	Color color = trace(pixelRay, 0, 1.0f);
+	return trace(pixelRay, 0, 1.0f);
+}
+
+Color
+RayTracer::shoot(REAL x, REAL y)
+//[]---------------------------------------------------[]
+//|  Shoot a pixel ray                                  |
+//|  @param x coordinate of the pixel                   |
+//|  @param y cordinates of the pixel                   |
+//|  @return RGB color of the pixel                     |
+//[]---------------------------------------------------[]
+{
+	Color color = sample(x, y);
 
 	// adjust RGB color
 	if (color.r > 1.0f)
@@ -425,69 +757,75 @@ RayTracer::trace(const Ray& ray, uint level, REAL weight)
 
 Color
 RayTracer::shade(const Ray& ray, uint level, REAL weight)
+//[]---------------------------------------------------[]
+//|  Shade a ray                                        |
+//|  Traversal only fills the hit record; the surface   |
+//|  attributes are evaluated once at the closest hit   |
+//[]---------------------------------------------------[]
 {
-	Intersection inter_;
+	Intersection hit;
 	numberOfRays++;
 	// if the pixel ray intersect some actor in scene
-	if (aggregate->intersect(ray, inter_))
+	if (aggregate->intersect(ray, hit))
 	{
 		numberOfHits++;
 		// default color
 		Color r_(0, 0, 0);
 
-		// treating the precision problem
-		inter_.p = inter_.p + 0.01 * inter_.triangle->normal(inter_);
+		// surface attributes at the hit point
+		const RenderScene::Surface& surface =
+			renderScene.getSurfaceOf(hit.instance);
+		vec3 normal = aggregate->normal(hit);
+		vec3 p = ray.origin + hit.distance * ray.direction;
 
-		// getting the array iterator of lights in scene
-		LightIterator lit = scene->getLightIterator();
+		// treating the precision problem: move the point off the
+		// surface, to the side the ray comes from
+		p += (normal.dot(ray.direction) < 0 ? 0.01f : -0.01f) * normal;
 
-		while (lit.current() != 0)
+		int nl = renderScene.getNumberOfLights();
+
+		for (int i = 0; i < nl; i++)
 		{
 			vec3 L;
 
 			// current light
-			Light* light = lit.current();
+			const RenderScene::Light* light = &renderScene.getLight(i);
 
 			// obtaining the light attr 
-			if (light->isDirectional())
+			if (light->directional)
 				L = light->position.versor();
 			// not directional light ..
 			else
 				// ray direction from light position to pixel ray intersection point
-				L = (inter_.p - light->position).versor();
+				L = (p - light->position).versor();
 
-			Ray shadowR(inter_.p, -L);
+			Ray shadowR(p, -L);
 			Intersection shadowRayInter;
 
 			// Now, lets see if the shadow ray intersect another actor in scene
-			// cos, in this case, the color of the material at point inter.p will
+			// cos, in this case, the color of the material at point p will
 			// be black
 			if (!aggregate->intersect(shadowR, shadowRayInter))
 			{
-				Color difuseColor = inter_.object->getMaterial()->surface.diffuse;
-				vec3 normal = inter_.triangle->normal(inter_);
-
-				if ((normal.negate()).dot(L) > 0.0)
-					r_ += difuseColor * (normal.negate()).dot(L); // updating the color 
+				REAL cosine = -normal.dot(L);
 
+				if (cosine > 0)
+					r_ += surface.diffuse * cosine; // updating the color
 			}
-			lit++;
 		}
 
 		// reflection color
 		Color Or;
 
-		Or = inter_.object->getMaterial()->surface.specular;
+		Or = surface.specular;
 
 		// verifying if is necessary trace reflection ray
 		if (Or.r != 0.0 && Or.g != 0.0 && Or.b != 0.0)
 		{
-			// N
-			vec3 normalAtP = inter_.triangle->normal(inter_);
 			// Rr = (V - (2 * (N*V))N
-			vec3 directionOfReflection = (ray.direction - (2 * normalAtP.dot(ray.direction)) * normalAtP).versor();
+			vec3 directionOfReflection = (ray.direction - (2 * normal.dot(ray.direction)) * normal).versor();
 
-			Ray reflectionRay(inter_.p, directionOfReflection, 0.0001f);
+			Ray reflectionRay(p, directionOfReflection, 0.0001f);
 
 			// getting the highest component value
 			float highestComponent = std::max(std::max(Or.r, Or.g), Or.b);
@@ -496,8 +834,8 @@ RayTracer::shade(const Ray& ray, uint level, REAL weight)
 			r_ += Or * trace(reflectionRay, level + 1, weight * highestComponent);
 		}
 
-		return inter_.object->getMaterial()->surface.ambient * scene->ambientLight + r_;
+		return surface.ambient * renderScene.ambientLight + r_;
 	}
 	else
-		return scene->backgroundColor;
+		return renderScene.backgroundColor;
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: RenderScene.cpp
+//  ========
+//  Source file for flat render scene.
+
+#include "RenderScene.h"
+
+using namespace Graphics;
+
+
+//////////////////////////////////////////////////////////
+//
+// RenderScene implementation
+// ===========
+void
+RenderScene::compile(const Scene& scene,
+  const DynamicBVH& aggregate,
+  const std::map<const Actor*, int32>& proxies)
+//[]---------------------------------------------------[]
+//|  Compile                                            |
+//|  The arrays keep their capacity, so compiling the   |
+//|  same scene again allocates nothing                 |
+//[]---------------------------------------------------[]
+{
+  backgroundColor = scene.backgroundColor;
+  ambientLight = scene.ambientLight;
+  lights.clear();
+  for (LightIterator lit(scene.getLightIterator()); lit;)
+  {
+    Graphics::Light* light = lit++;
+    Light l;
+
+    l.position = light->position;
+    l.color = light->color;
+    l.directional = light->isDirectional();
+    lights.push_back(l);
+  }
+
+  int32 n = 0;
+
+  for (const auto& p : proxies)
+    n = dMax(n, p.second + 1);
+
+  // a proxy not in the map is a free node of the BVH
+  std::map<const Material*, int> index;
+
+  surfaces.clear();
+  materials.assign(n, -1);
+  for (const auto& p : proxies)
+  {
+    const Model* model = aggregate.getModel(p.second);
+    const Material* material = model->getMaterial();
+
+    if (material == 0)
+      material = Material::getDefault();
+
+    auto mit = index.find(material);
+
+    if (mit == index.end())
+    {
+      Surface s;
+
+      s.ambient = material->surface.ambient;
+      s.diffuse = material->surface.diffuse;
+      s.specular = material->surface.specular;
+      mit = index.insert(std::make_pair(material, (int)surfaces.size())).first;
+      surfaces.push_back(s);
+    }
+    materials[p.second] = mit->second;
+  }
+}
@@ -64,6 +64,24 @@ Scene::addActor(Actor* actor)
     System::makeUse(actor);
     if (!modifiedBounds)
       bounds.inflate(actor->model->boundingBox());
+    for (int i = 0, n = listeners.size(); i < n; i++)
+      listeners[i]->actorAdded(*this, actor);
+  }
+}
+
+void
+Scene::updateActor(Actor* actor)
+//[]---------------------------------------------------[]
+//|  Update actor                                       |
+//|  Must be invoked after the model or the transform   |
+//|  of an actor of the scene has been changed          |
+//[]---------------------------------------------------[]
+{
+  if (actor != 0 && actor->getScene() == this)
+  {
+    modifiedBounds = true;
+    for (int i = 0, n = listeners.size(); i < n; i++)
+      listeners[i]->actorModified(*this, actor);
   }
 }
 
@@ -75,6 +93,8 @@ Scene::deleteActor(Actor* actor)
 {
   if (actor != 0 && actor->getScene() == this)
   {
+    for (int i = 0, n = listeners.size(); i < n; i++)
+      listeners[i]->actorRemoved(*this, actor);
     actors.remove(*actor);
     actor->scene = 0;
     actor->release();
@@ -130,6 +150,8 @@ Scene::deleteActors()
 {
   for (Actor* actor; (actor = actors.peekHead()) != 0;)
   {
+    for (int i = 0, n = listeners.size(); i < n; i++)
+      listeners[i]->actorRemoved(*this, actor);
     actors.remove(*actor);
     actor->scene = 0;
     actor->release();
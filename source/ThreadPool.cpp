@@ -0,0 +1,117 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                        GVSG Foundation Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: ThreadPool.cpp
+//  ========
+//  Source file for thread pool.
+
+#include "ThreadPool.h"
+
+using namespace System;
+
+
+//////////////////////////////////////////////////////////
+//
+// ThreadPool implementation
+// ==========
+ThreadPool::ThreadPool(int n):
+  stopping(false)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // The thread that submits tasks usually helps to run them
+  if (n <= 0)
+    n = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+  for (int i = 0; i < n; i++)
+    workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+//[]---------------------------------------------------[]
+//|  Destructor                                         |
+//[]---------------------------------------------------[]
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  ready.notify_all();
+  for (auto& w : workers)
+    w.join();
+  // Without workers, the tasks left run here
+  while (runPending())
+    ;
+}
+
+void
+ThreadPool::submit(std::function<void()>&& task)
+//[]---------------------------------------------------[]
+//|  Submit                                             |
+//[]---------------------------------------------------[]
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    tasks.push_back(std::move(task));
+  }
+  ready.notify_one();
+}
+
+bool
+ThreadPool::runPending()
+//[]---------------------------------------------------[]
+//|  Run pending                                        |
+//[]---------------------------------------------------[]
+{
+  std::function<void()> task;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (tasks.empty())
+      return false;
+    task = std::move(tasks.front());
+    tasks.pop_front();
+  }
+  task();
+  return true;
+}
+
+void
+ThreadPool::work()
+//[]---------------------------------------------------[]
+//|  Work                                               |
+//[]---------------------------------------------------[]
+{
+  for (;;)
+  {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> guard(lock);
+
+      ready.wait(guard, [this]() { return stopping || !tasks.empty(); });
+      if (tasks.empty())
+        return;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+ThreadPool&
+ThreadPool::getDefault()
+//[]---------------------------------------------------[]
+//|  Get default                                        |
+//[]---------------------------------------------------[]
+{
+  static ThreadPool pool;
+  return pool;
+}
@@ -0,0 +1,124 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Library                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: TiledImage.cpp
+//  ========
+//  Source file for memory-mapped tiled image.
+
+#include <stdio.h>
+#include <string.h>
+#include "TiledImage.h"
+
+using namespace Graphics;
+
+
+//////////////////////////////////////////////////////////
+//
+// TiledImage implementation
+// ==========
+TiledImage*
+TiledImage::create(const char* fileName, int w, int h, int tileSize)
+//[]---------------------------------------------------[]
+//|  Create                                             |
+//[]---------------------------------------------------[]
+{
+  if (w <= 0 || h <= 0 || tileSize <= 0)
+    return 0;
+
+  char header[64];
+  int n = sprintf(header, "P6\n%d %d\n255\n", w, h);
+  TiledImage* image = new TiledImage(w, h, tileSize);
+
+  if (!image->file.create(fileName, n + (size_t)w * h * sizeof(Pixel)))
+  {
+    delete image;
+    return 0;
+  }
+  memcpy(image->file.data(), header, n);
+  image->offset = n;
+  return image;
+}
+
+TiledImage::TiledImage(int w, int h, int ts):
+  offset(0),
+  W(w),
+  H(h),
+  tileSize(ts),
+  tilesX((w + ts - 1) / ts),
+  tilesY((h + ts - 1) / ts),
+  tilesWritten(tilesY, 0)
+//[]---------------------------------------------------[]
+//|  Constructor                                        |
+//[]---------------------------------------------------[]
+{
+  // do nothing
+}
+
+void
+TiledImage::getTile(int t, int& x, int& y, int& w, int& h) const
+//[]---------------------------------------------------[]
+//|  Get tile                                           |
+//[]---------------------------------------------------[]
+{
+  x = t % tilesX * tileSize;
+  y = t / tilesX * tileSize;
+  w = dMin(tileSize, W - x);
+  h = dMin(tileSize, H - y);
+}
+
+void
+TiledImage::release(size_t begin, size_t n)
+//[]---------------------------------------------------[]
+//|  Release                                            |
+//|  Flushes a range of the file and drops its pages    |
+//[]---------------------------------------------------[]
+{
+  file.flush(begin, n);
+  file.discard(begin, n);
+}
+
+void
+TiledImage::write(int j, Pixel pixels[])
+//[]---------------------------------------------------[]
+//|  Write                                              |
+//[]---------------------------------------------------[]
+{
+  if (j < 0 || j >= H)
+    return;
+
+  size_t begin = pixelOffset(0, j);
+  size_t n = W * sizeof(Pixel);
+
+  memcpy(file.data() + begin, pixels, n);
+  release(begin, n);
+}
+
+void
+TiledImage::writeTile(int t, const Pixel pixels[])
+//[]---------------------------------------------------[]
+//|  Write tile                                         |
+//|  Each row of the tile is a slice of a row of the    |
+//|  file, whose pages are shared with the neighbor     |
+//|  tiles; the rows of a band are contiguous in the    |
+//|  file and released together after its last tile     |
+//[]---------------------------------------------------[]
+{
+  int x, y, w, h;
+
+  getTile(t, x, y, w, h);
+
+  size_t n = w * sizeof(Pixel);
+
+  for (int j = 0; j < h; j++, pixels += w)
+    memcpy(file.data() + pixelOffset(x, y + j), pixels, n);
+  if (++tilesWritten[t / tilesX] == tilesX)
+    // the top row of the band comes first in the file
+    release(pixelOffset(0, y + h - 1), (size_t)h * W * sizeof(Pixel));
+}
@@ -12,7 +12,12 @@
 //  ========
 //  Source file for simple triangle mesh.
 
+#include <algorithm>
 #include <memory.h>
+#include <numeric>
+#include <stdint.h>
+#include <vector>
+#include "ThreadPool.h"
 #include "TriangleMesh.h"
 
 //
@@ -43,12 +48,48 @@ printVec3(FILE*f, const char* s, const vec3& p)
   fprintf(f, "%s<%g, %g, %g>\n", s, p.x, p.y, p.z);
 }
 
+// Vertices or triangles processed by a task of the default thread pool;
+// smaller meshes are processed by the calling thread alone
+#define MESH_RANGE_SIZE (1 << 14)
+
+// Spreads the 10 low bits of v to every third bit
+inline uint32_t
+expandBits(uint32_t v)
+{
+  v &= 0x3ff;
+  v = (v | v << 16) & 0x030000ff;
+  v = (v | v << 8) & 0x0300f00f;
+  v = (v | v << 4) & 0x030c30c3;
+  v = (v | v << 2) & 0x09249249;
+  return v;
+}
+
+// Morton code of a point with coordinates in [0, 1023]
+inline uint32_t
+mortonCode(const vec3& p)
+{
+  return expandBits((uint32_t)p.x) << 2 |
+    expandBits((uint32_t)p.y) << 1 |
+    expandBits((uint32_t)p.z);
+}
+
+// Bounds of the items of ranges of MESH_RANGE_SIZE items
+inline Bounds3
+rangeBounds(std::vector<Bounds3>& ranges)
+{
+  Bounds3 box;
+
+  for (const Bounds3& b : ranges)
+    box.inflate(b);
+  return box;
+}
+
 
 //////////////////////////////////////////////////////////
 //
 // TriangleMesh implementation
 // ============
-uint TriangleMesh::nextId;
+std::atomic<uint> TriangleMesh::nextId;
 
 TriangleMesh::Arrays
 TriangleMesh::Arrays::copy() const
@@ -87,20 +128,49 @@ TriangleMesh::clone() const
   return new TriangleMesh(data.copy());
 }
 
-Bounds3
-TriangleMesh::boundingBox() const
+void
+TriangleMesh::computeBounds() const
+//[]---------------------------------------------------[]
+//|  Compute bounds                                     |
+//[]---------------------------------------------------[]
 {
-  Bounds3 box;
+  int nv = data.numberOfVertices;
+  std::vector<Bounds3> ranges((nv + MESH_RANGE_SIZE - 1) / MESH_RANGE_SIZE);
 
-  for (int i = 0; i < data.numberOfVertices; i++)
-    box.inflate(data.vertices[i]);
-  return box;
+  ThreadPool::getDefault().forEachRange(nv, MESH_RANGE_SIZE,
+    [&](int begin, int end)
+    {
+      Bounds3& box = ranges[begin / MESH_RANGE_SIZE];
+
+      for (int i = begin; i < end; i++)
+        box.inflate(data.vertices[i]);
+    });
+
+  // The lock is not held while computing: the calling thread may run
+  // other tasks meanwhile, which may need the bounds too
+  std::lock_guard<std::mutex> guard(boundsLock);
+
+  if (!boundsValid.load(std::memory_order_relaxed))
+  {
+    bounds = rangeBounds(ranges);
+    boundsValid.store(true, std::memory_order_release);
+  }
 }
 
 void
 TriangleMesh::computeNormals()
+//[]---------------------------------------------------[]
+//|  Compute normals                                    |
+//|  The normal of a vertex is the normalized sum of    |
+//|  the normals of its triangles. Tasks compute the    |
+//|  triangle normals and then gather them by vertex,   |
+//|  so no two tasks write to the same vertex; the sums |
+//|  are taken in the order of the triangles, as by a   |
+//|  serial loop                                        |
+//[]---------------------------------------------------[]
 {
   int nv = data.numberOfVertices;
+  int nt = data.numberOfTriangles;
 
   if (data.normals == 0)
     data.normals = new vec3[nv];
@@ -111,32 +181,217 @@ TriangleMesh::computeNormals()
   }
   data.numberOfNormals = nv;
 
-  vec3* normals = data.normals;
-  Triangle* t = data.triangles;
+  ThreadPool& pool = ThreadPool::getDefault();
+  const Triangle* triangles = data.triangles;
+  std::vector<vec3> triangleNormals(nt);
 
-  memset(normals, 0, nv * sizeof(vec3));
-  for (int i = 0; i < data.numberOfTriangles; i++, t++)
+  pool.forEachRange(nt, MESH_RANGE_SIZE, [&](int begin, int end)
   {
-    int v0 = t->v[0];
-    int v1 = t->v[1];
-    int v2 = t->v[2];
-    vec3 N = triangleNormal(data.vertices, v0, v1, v2);
+    for (int i = begin; i < end; i++)
+      triangleNormals[i] = triangleNormal(data.vertices, triangles[i].v);
+  });
 
-    normals[v0] += N;
-    normals[v1] += N;
-    normals[v2] += N;
-  }
+  // Triangles of each vertex, in order: those of vertex i are
+  // corners[first[i]] to corners[first[i + 1] - 1]
+  std::vector<int> first(nv + 1, 0);
+  std::vector<int> corners(3 * nt);
+
+  for (int i = 0; i < nt; i++)
+    for (int k = 0; k < 3; k++)
+      first[triangles[i].v[k] + 1]++;
   for (int i = 0; i < nv; i++)
-    normals[i].normalize();
+    first[i + 1] += first[i];
+  {
+    std::vector<int> next(first.begin(), first.end() - 1);
+
+    for (int i = 0; i < nt; i++)
+      for (int k = 0; k < 3; k++)
+        corners[next[triangles[i].v[k]]++] = i;
+  }
+
+  vec3* normals = data.normals;
+
+  pool.forEachRange(nv, MESH_RANGE_SIZE, [&](int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      vec3 N = vec3::null();
+
+      for (int c = first[i]; c < first[i + 1]; c++)
+        N += triangleNormals[corners[c]];
+      normals[i] = N.normalize();
+    }
+  });
 }
 
 void
 TriangleMesh::transform(const mat4& m)
+//[]---------------------------------------------------[]
+//|  Transform                                          |
+//|  The new bounds are taken while the vertices are    |
+//|  transformed                                        |
+//[]---------------------------------------------------[]
+{
+  ThreadPool& pool = ThreadPool::getDefault();
+  int nv = data.numberOfVertices;
+  std::vector<Bounds3> ranges((nv + MESH_RANGE_SIZE - 1) / MESH_RANGE_SIZE);
+
+  pool.forEachRange(nv, MESH_RANGE_SIZE, [&](int begin, int end)
+  {
+    Bounds3& box = ranges[begin / MESH_RANGE_SIZE];
+
+    for (int i = begin; i < end; i++)
+      box.inflate(data.vertices[i] = m.transform3x4(data.vertices[i]));
+  });
+  pool.forEachRange(data.numberOfNormals, MESH_RANGE_SIZE,
+    [&](int begin, int end)
+    {
+      for (int i = begin; i < end; i++)
+        data.normals[i] = m.transformVector(data.normals[i]).versor();
+    });
+
+  std::lock_guard<std::mutex> guard(boundsLock);
+
+  bounds = rangeBounds(ranges);
+  boundsValid.store(true, std::memory_order_release);
+}
+
+void
+TriangleMesh::optimize()
+//[]---------------------------------------------------[]
+//|  Optimize                                           |
+//|  Welds the vertices with equal position, normal and |
+//|  color, drops the triangles with repeated vertices  |
+//|  or no area, sorts the triangles along a Z-order    |
+//|  curve through their centers and numbers the        |
+//|  vertices by first use, dropping unused ones        |
+//[]---------------------------------------------------[]
 {
-  for (int i = 0; i < data.numberOfVertices; i++)
-    data.vertices[i] = m.transform3x4(data.vertices[i]);
-  for (int i = 0; i < data.numberOfNormals; i++)
-    data.normals[i] = m.transformVector(data.normals[i]).versor();
+  int nv = data.numberOfVertices;
+  int nt = data.numberOfTriangles;
+
+  // Normals and colors must be per vertex
+  if ((data.normals != 0 && data.numberOfNormals != nv) ||
+    (data.vertexColors != 0 && data.numberOfVertexColors != nv))
+    return;
+
+  // Equal vertices are neighbors in this order
+  auto compare = [this](int a, int b)
+  {
+    int c = memcmp(data.vertices + a, data.vertices + b, sizeof(vec3));
+
+    if (c == 0 && data.normals != 0)
+      c = memcmp(data.normals + a, data.normals + b, sizeof(vec3));
+    if (c == 0 && data.vertexColors != 0)
+      c = memcmp(data.vertexColors + a, data.vertexColors + b, sizeof(Color));
+    return c;
+  };
+  std::vector<int> order(nv);
+  std::vector<int> weld(nv);
+
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b)
+  {
+    return compare(a, b) < 0;
+  });
+  for (int i = 0; i < nv; i++)
+    weld[order[i]] = i > 0 && compare(order[i - 1], order[i]) == 0 ?
+      weld[order[i - 1]] :
+      order[i];
+
+  std::vector<Triangle> triangles;
+
+  triangles.reserve(nt);
+  for (int i = 0; i < nt; i++)
+  {
+    Triangle t;
+
+    for (int k = 0; k < 3; k++)
+      t.v[k] = weld[data.triangles[i].v[k]];
+    if (t.v[0] == t.v[1] || t.v[1] == t.v[2] || t.v[2] == t.v[0])
+      continue;
+
+    const vec3& p0 = data.vertices[t.v[0]];
+    vec3 N = (data.vertices[t.v[1]] - p0).cross(data.vertices[t.v[2]] - p0);
+
+    if (N.x == 0 && N.y == 0 && N.z == 0)
+      continue;
+    triangles.push_back(t);
+  }
+  nt = (int)triangles.size();
+
+  // Z-order of the triangle centers on a 1024^3 grid over the bounds
+  Bounds3 box = boundingBox();
+  vec3 size = box.size();
+  vec3 scale;
+  std::vector<std::pair<uint32_t, int>> keys(nt);
+
+  for (int k = 0; k < 3; k++)
+    scale[k] = size[k] > 0 ? 1023 / size[k] : 0;
+  ThreadPool::getDefault().forEachRange(nt, MESH_RANGE_SIZE,
+    [&](int begin, int end)
+    {
+      for (int i = begin; i < end; i++)
+      {
+        vec3 p = triangleCenter(data.vertices, triangles[i].v) - box.getMin();
+
+        keys[i].first = mortonCode(vec3(p.x * scale.x,
+          p.y * scale.y,
+          p.z * scale.z));
+        keys[i].second = i;
+      }
+    });
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<int> index(nv, -1);
+  Triangle* sorted = new Triangle[nt];
+  int n = 0;
+
+  for (int i = 0; i < nt; i++)
+    for (int k = 0; k < 3; k++)
+    {
+      int& j = index[triangles[keys[i].second].v[k]];
+
+      if (j < 0)
+        j = n++;
+      sorted[i].v[k] = j;
+    }
+
+  Arrays a;
+
+  a.numberOfVertices = n;
+  a.numberOfTriangles = nt;
+  a.vertices = new vec3[n];
+  a.triangles = sorted;
+  if (data.normals != 0)
+  {
+    a.numberOfNormals = n;
+    a.normals = new vec3[n];
+  }
+  if (data.vertexColors != 0)
+  {
+    a.numberOfVertexColors = n;
+    a.vertexColors = new Color[n];
+  }
+  for (int i = 0; i < nv; i++)
+  {
+    int j = index[i];
+
+    if (j < 0)
+      continue;
+    a.vertices[j] = data.vertices[i];
+    if (a.normals != 0)
+      a.normals[j] = data.normals[i];
+    if (a.vertexColors != 0)
+      a.vertexColors[j] = data.vertexColors[i];
+  }
+  delete []data.vertices;
+  delete []data.normals;
+  delete []data.vertexColors;
+  delete []data.triangles;
+  data = a;
+  // Unused vertices are gone
+  boundsValid.store(false, std::memory_order_release);
 }
 
 void
@@ -31,38 +31,8 @@ TriangleShape::intersect(const Ray& ray, Intersection& hit) const
   const vec3& p0 = vertices[v[0]];
   const vec3& p1 = vertices[v[1]];
   const vec3& p2 = vertices[v[2]];
-  vec3 e1 = p1 - p0;
-  vec3 e2 = p2 - p0;
-  vec3 s1 = ray.direction.cross(e2);
-  REAL invDet = s1.dot(e1);
-
-  if (Math::isZero(invDet))
-    return false;
-  invDet = Math::inverse(invDet);
-
-  // Compute first barycentric coordinate
-  vec3 s = ray.origin - p0;
-  REAL b1 = s.dot(s1) * invDet;
-
-  if (b1 < 0 || b1 > 1)
-    return false;
-
-  // Compute second barycentric coordinate
-  vec3 s2 = s.cross(e1);
-  REAL b2 = ray.direction.dot(s2) * invDet;
-
-  if (b2 < 0 || b1 + b2 > 1)
-    return false;
-
-  // Compute distance to the intersection point
-  REAL t = e2.dot(s2) * invDet;
-
-  if (t < ray.minD || t > ray.maxD)
-    return false;
-  hit.distance = t;
-  hit.triangle = this;
-  hit.p.set(1 - b1 - b2, b1, b2);
-  return true;
+
+  return intersectTriangle(p0, p1, p2, ray, hit);
 }
 
 vec3
@@ -80,7 +50,9 @@ TriangleShape::normal(const Intersection& hit) const
   const vec3& N1 = normals[v[1]];
   const vec3& N2 = normals[v[2]];
 
-  return triangleInterpolate<vec3>(hit.p, N0, N1, N2).versor();
+  vec3 p(1 - hit.u - hit.v, hit.u, hit.v);
+
+  return triangleInterpolate<vec3>(p, N0, N1, N2).versor();
 }
 
 const Material*
@@ -111,6 +83,82 @@ TriangleShape::boundingBox() const
   return b;
 }
 
+Bounds3
+TriangleShape::clippedBoundingBox(const Bounds3& box) const
+//[]---------------------------------------------------[]
+//|  Clipped bounding box                               |
+//[]---------------------------------------------------[]
+{
+  const vec3* vertices = mesh->getData().vertices;
+
+  return clippedTriangleBounds(vertices[v[0]], vertices[v[1]], vertices[v[2]],
+    box);
+}
+
+Bounds3
+Graphics::clippedTriangleBounds(const vec3& v0,
+  const vec3& v1,
+  const vec3& v2,
+  const Bounds3& box)
+//[]---------------------------------------------------[]
+//|  Clipped triangle bounds                            |
+//|  Clips a triangle against the six planes of box     |
+//|  (Sutherland-Hodgman) and returns the bounds of the |
+//|  resulting polygon                                  |
+//[]---------------------------------------------------[]
+{
+  // A triangle clipped by six planes has at most nine vertices
+  vec3 buffer[2][9];
+  vec3* poly = buffer[0];
+  vec3* temp = buffer[1];
+  int n = 3;
+
+  poly[0] = v0;
+  poly[1] = v1;
+  poly[2] = v2;
+  for (int plane = 0; plane < 6 && n > 0; plane++)
+  {
+    int axis = plane >> 1;
+    // Keep p[axis] >= d for min planes and p[axis] <= d for max planes
+    REAL s = plane & 1 ? -1 : 1;
+    REAL d = box[plane & 1][axis] * s;
+    int m = 0;
+
+    for (int i = 0, j = n - 1; i < n; j = i++)
+    {
+      const vec3& a = poly[j];
+      const vec3& b = poly[i];
+      REAL da = a[axis] * s - d;
+      REAL db = b[axis] * s - d;
+
+      if ((da >= 0) != (db >= 0))
+        temp[m++] = a + (b - a) * (da / (da - db));
+      if (db >= 0)
+        temp[m++] = b;
+    }
+    dSwap(poly, temp);
+    n = m;
+  }
+
+  Bounds3 b;
+
+  if (n == 0)
+    return b;
+  for (int i = 0; i < n; i++)
+    b.inflate(poly[i]);
+
+  // Snap the bounds to box to get rid of round-off errors
+  vec3 p1 = b.getMin();
+  vec3 p2 = b.getMax();
+
+  for (int i = 0; i < 3; i++)
+  {
+    p1[i] = dMax(p1[i], box.getMin()[i]);
+    p2[i] = dMax(dMin(p2[i], box.getMax()[i]), p1[i]);
+  }
+  return Bounds3(p1, p2);
+}
+
 
 //////////////////////////////////////////////////////////
 //
@@ -135,16 +183,30 @@ TriangleMeshShape::canIntersect() const
 }
 
 Array<ModelPtr>
-TriangleMeshShape::refine() const
+TriangleMeshShape::refine(Arena* arena) const
 //[]---------------------------------------------------[]
 //|  Refine                                             |
+//|  The triangles are placed in the arena, if any,     |
+//|  which then owns them                               |
 //[]---------------------------------------------------[]
 {
   int nt = mesh->getData().numberOfTriangles;
   Array<ModelPtr> a(nt);
 
+  if (arena == 0)
+  {
+    for (int t = 0; t < nt; t++)
+      a.add(new TriangleShape(mesh, t));
+    return a;
+  }
+
+  TriangleShape* triangles = arena->allocate<TriangleShape>(nt);
+
+  // The extra use keeps a triangle from deleting itself when its
+  // last pointer is released; the arena destroys it
   for (int t = 0; t < nt; t++)
-    a.add(new TriangleShape(mesh, t));
+    a.add(makeUse(new(triangles + t) TriangleShape(mesh, t)));
+  arena->own(triangles, nt);
   return a;
 }
 
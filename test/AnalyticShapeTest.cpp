@@ -0,0 +1,94 @@
+//[]------------------------------------------------------------------------[]
+//|                                                                          |
+//|                          GVSG Graphics Classes                           |
+//|                               Version 1.0                                |
+//|                                                                          |
+//|              Copyright 2010-2016, Paulo Aristarco Pagliosa              |
+//|              All Rights Reserved.                                        |
+//|                                                                          |
+//[]------------------------------------------------------------------------[]
+//
+//  OVERVIEW: AnalyticShapeTest.cpp
+//  ========
+//  Regression test for the intersection of scaled analytic shapes.
+//
+//  Build it with the library sources, but the GL ones and Main.cpp, and
+//  run it; it returns nonzero if any case fails. The hit distance of a
+//  ray must not depend on the scale of the shape it hits.
+
+#include <math.h>
+#include <stdio.h>
+#include "AnalyticShape.h"
+#include "MeshCache.h"
+
+using namespace Graphics;
+
+static int failures;
+
+// Intersects a ray with an instance of a shape of uniform scale s,
+// centered at the origin, and checks the hit distance
+static void
+check(const char* name,
+  AnalyticShape::Type type,
+  TriangleMesh* mesh,
+  REAL s,
+  const vec3& origin,
+  const vec3& direction,
+  REAL expected)
+{
+  AnalyticShape* shape = new AnalyticShape(type, mesh);
+
+  shape->setTransform(vec3::null(), quat::identity(), vec3(s, s, s));
+
+  ModelInstance* instance = new ModelInstance(*shape->getShape(), *shape);
+  Intersection hit;
+  bool ok = instance->intersect(Ray(origin, direction), hit) &&
+    fabs(hit.distance - expected) <= REAL(1e-4) * expected;
+
+  if (!ok)
+    failures++;
+  printf("%s %s(%g): t = %g, expected %g\n",
+    ok ? "PASS" : "FAIL",
+    name,
+    s,
+    hit.distance,
+    expected);
+  delete instance;
+  delete shape;
+}
+
+int
+main()
+{
+  const REAL scales[] = {1, 100, 3000, 5000, 20000, 1e7};
+
+  for (REAL s : scales)
+  {
+    // from 3s away along z to the near side of a sphere of radius s
+    check("sphere",
+      AnalyticShape::Sphere,
+      MeshCache::getSphere(),
+      s,
+      vec3(0, 0, -3 * s),
+      vec3(0, 0, 1),
+      2 * s);
+    // down the axis to the top cap, at y = s / 2
+    check("cylinder",
+      AnalyticShape::Cylinder,
+      MeshCache::getCylinder(),
+      s,
+      vec3(0, 2 * s, 0),
+      vec3(0, -1, 0),
+      REAL(1.5) * s);
+    // up the axis to the base, at y = 0
+    check("cone",
+      AnalyticShape::Cone,
+      MeshCache::getCone(),
+      s,
+      vec3(0, -s, 0),
+      vec3(0, 1, 0),
+      s);
+  }
+  MeshCache::clear();
+  return failures != 0;
+}